@@ -21,51 +21,38 @@
  *******************************************************************************/
 #include <set>
 #include <map>
+#include <algorithm>
 #include "Sample.hpp"
 
 namespace loc{
     
-    bool Sample::equalLocation(Sample sample1, Sample sample2){
-        Location loc1 = sample1.location();
-        Location loc2 = sample2.location();
-        return Location::equals(loc1, loc2);
+    bool Sample::equalLocation(const Sample& sample1, const Sample& sample2){
+        return Location::equals(sample1.location(), sample2.location());
     }
     
-    std::vector<std::vector<Sample>> Sample::splitSamplesToConsecutiveSamples(std::vector<Sample> samples){
+    std::vector<std::vector<Sample>> Sample::splitSamplesToConsecutiveSamples(const std::vector<Sample>& samples){
         
-        Sample prevSample = samples.at(0);
         std::vector<std::vector<Sample>> samplesList;
         for(auto iter = samples.begin(); iter!=samples.end(); iter++){
-            if(iter==samples.begin()){
-                std::vector<Sample> samplesTmp;
-                samplesTmp.push_back(*iter);
-                samplesList.push_back(samplesTmp);
+            if(iter!=samples.begin() && Sample::equalLocation(*(iter-1), *iter)){
+                samplesList.back().push_back(*iter);
             }else{
-                if(Sample::equalLocation(prevSample, *iter)){
-                    samplesList.back().push_back(*iter);
-                }else{
-                    std::vector<Sample> samplesTmp;
-                    samplesTmp.push_back(*iter);
-                    samplesList.push_back(samplesTmp);
-                }
+                samplesList.push_back(std::vector<Sample>{*iter});
             }
-            prevSample = *iter;
         }
         return samplesList;
     }
     
-    Sample Sample::mean(std::vector<Sample> samples){
+    Sample Sample::mean(const std::vector<Sample>& samples){
         
         long timeSum = 0;
         std::vector<Location> locs;
         std::vector<Beacons> beaconsList;
         
-        for(Sample smp :samples){
+        for(const Sample& smp :samples){
             timeSum += smp.timestamp();
-            Location loc = smp.location();
-            Beacons beacons = smp.beacons();
-            locs.push_back(loc);
-            beaconsList.push_back(beacons);
+            locs.push_back(smp.location());
+            beaconsList.push_back(smp.beacons());
         }
         
         long timestamp = timeSum/samples.size();
@@ -84,9 +71,9 @@ namespace loc{
     }
     
     
-    std::vector<Sample> Sample::mean(std::vector<std::vector<Sample>> samplesList){
+    std::vector<Sample> Sample::mean(const std::vector<std::vector<Sample>>& samplesList){
         std::vector<Sample> sampleMeans;
-        for(std::vector<Sample> samples: samplesList){
+        for(const std::vector<Sample>& samples: samplesList){
             Sample smp = Sample::mean(samples);
             sampleMeans.push_back(smp);
         }
@@ -177,4 +164,157 @@ namespace loc{
         return smps;
     }
     
+    
+    void RssiStatistics::add(double rssi){
+        count++;
+        double delta = rssi - mean;
+        mean += delta/count;
+        m2 += delta*(rssi - mean);
+    }
+    
+    void RssiStatistics::merge(const RssiStatistics& stats){
+        if(stats.count==0){
+            return;
+        }
+        int countNew = count + stats.count;
+        double delta = stats.mean - mean;
+        mean += delta*stats.count/countNew;
+        m2 += stats.m2 + delta*delta*count*stats.count/countNew;
+        count = countNew;
+    }
+    
+    double RssiStatistics::squareErrorSum(double ypred) const{
+        double diff = mean - ypred;
+        return m2 + count*diff*diff;
+    }
+    
+    void AggregatedSample::add(const Sample& sample){
+        if(count==0){
+            location = sample.location();
+        }
+        timestampSum += sample.timestamp();
+        count++;
+        for(const Beacon& b: sample.beacons()){
+            const auto& id = b.id();
+            auto iter = std::lower_bound(beaconStatistics.begin(), beaconStatistics.end(), id,
+                                         [](const std::pair<BeaconId, RssiStatistics>& pair, const BeaconId& id){
+                                             return pair.first < id;
+                                         });
+            if(iter==beaconStatistics.end() || !(iter->first==id)){
+                iter = beaconStatistics.insert(iter, std::make_pair(id, RssiStatistics()));
+            }
+            iter->second.add(b.rssi());
+        }
+    }
+    
+    void AggregatedSample::merge(const AggregatedSample& aggregatedSample){
+        if(count==0){
+            location = aggregatedSample.location;
+        }
+        timestampSum += aggregatedSample.timestampSum;
+        count += aggregatedSample.count;
+        for(const auto& pair: aggregatedSample.beaconStatistics){
+            auto iter = std::lower_bound(beaconStatistics.begin(), beaconStatistics.end(), pair,
+                                         [](const std::pair<BeaconId, RssiStatistics>& p1, const std::pair<BeaconId, RssiStatistics>& p2){
+                                             return p1.first < p2.first;
+                                         });
+            if(iter==beaconStatistics.end() || !(iter->first==pair.first)){
+                beaconStatistics.insert(iter, pair);
+            }else{
+                iter->second.merge(pair.second);
+            }
+        }
+    }
+    
+    Sample AggregatedSample::mean() const{
+        long timestamp = timestampSum/count;
+        Beacons beacons;
+        for(const auto& pair: beaconStatistics){
+            beacons.push_back(Beacon(pair.first, pair.second.mean));
+        }
+        beacons.timestamp(timestamp);
+        
+        Sample sampleMean;
+        sampleMean.timestamp(timestamp);
+        sampleMean.location(location);
+        sampleMean.beacons(beacons);
+        return sampleMean;
+    }
+    
+    SampleAggregator& SampleAggregator::add(const Sample& sample){
+        if(aggregatedSamples_.size()==0 || !Location::equals(aggregatedSamples_.back().location, sample.location())){
+            aggregatedSamples_.push_back(AggregatedSample());
+        }
+        aggregatedSamples_.back().add(sample);
+        nSamples_++;
+        return *this;
+    }
+    
+    SampleAggregator& SampleAggregator::add(const Samples& samples){
+        for(const Sample& sample: samples){
+            add(sample);
+        }
+        return *this;
+    }
+    
+    void SampleAggregator::clear(){
+        aggregatedSamples_.clear();
+        nSamples_ = 0;
+    }
+    
+    size_t SampleAggregator::nSamples() const{
+        return nSamples_;
+    }
+    
+    const std::vector<AggregatedSample>& SampleAggregator::aggregatedSamples() const{
+        return aggregatedSamples_;
+    }
+    
+    std::vector<Sample> SampleAggregator::meanSamples() const{
+        std::vector<Sample> sampleMeans;
+        sampleMeans.reserve(aggregatedSamples_.size());
+        for(const AggregatedSample& aggregatedSample: aggregatedSamples_){
+            sampleMeans.push_back(aggregatedSample.mean());
+        }
+        return sampleMeans;
+    }
+    
+    std::vector<Location> SampleAggregator::extractUniqueLocations() const{
+        std::set<Location> locationSet;
+        for(const AggregatedSample& aggregatedSample: aggregatedSamples_){
+            locationSet.insert(aggregatedSample.location);
+        }
+        return std::vector<Location>(locationSet.begin(), locationSet.end());
+    }
+    
+    SampleAggregator SampleAggregator::filterUnregisteredBeacons(const BLEBeacons& bleBeacons) const{
+        SampleAggregator aggregator;
+        auto indexMap = BLEBeacon::constructBeaconIdToIndexMap(bleBeacons);
+        for(const AggregatedSample& aggregatedSample: aggregatedSamples_){
+            AggregatedSample filtered;
+            filtered.location = aggregatedSample.location;
+            filtered.timestampSum = aggregatedSample.timestampSum;
+            filtered.count = aggregatedSample.count;
+            for(const auto& pair: aggregatedSample.beaconStatistics){
+                if(indexMap.count(pair.first)>0){
+                    filtered.beaconStatistics.push_back(pair);
+                }
+            }
+            if(filtered.beaconStatistics.size()==0){
+                continue;
+            }
+            // groups separated only by removed groups are joined
+            if(aggregator.aggregatedSamples_.size()>0 && Location::equals(aggregator.aggregatedSamples_.back().location, filtered.location)){
+                aggregator.aggregatedSamples_.back().merge(filtered);
+            }else{
+                aggregator.aggregatedSamples_.push_back(filtered);
+            }
+            aggregator.nSamples_ += filtered.count;
+        }
+        if(aggregator.aggregatedSamples_.size()==0){
+            BOOST_THROW_EXCEPTION(LocException("No sample contains beacon signals from the registered beacons"));
+        }
+        return aggregator;
+    }
+    
 }
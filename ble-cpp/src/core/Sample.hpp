@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <vector>
 #include <sstream>
+#include <utility>
 #include "Location.hpp"
 #include "Beacon.hpp"
 #include "BLEBeacon.hpp"
@@ -55,7 +56,7 @@ namespace loc{
             return this;
         }
         
-        Location location() const{
+        const Location& location() const{
             return location_;
         }
         
@@ -64,7 +65,7 @@ namespace loc{
             return this;
         }
         
-        Beacons beacons() const{
+        const Beacons& beacons() const{
             return beacons_;
         }
         
@@ -85,12 +86,12 @@ namespace loc{
         }
         
         
-        static bool equalLocation(Sample sample1, Sample sample2);
+        static bool equalLocation(const Sample& sample1, const Sample& sample2);
         
-        static std::vector<std::vector<Sample>> splitSamplesToConsecutiveSamples(std::vector<Sample> samples);
+        static std::vector<std::vector<Sample>> splitSamplesToConsecutiveSamples(const std::vector<Sample>& samples);
         
-        static Sample mean(std::vector<Sample> samples);
-        static std::vector<Sample> mean(std::vector<std::vector<Sample>> samplesList);
+        static Sample mean(const std::vector<Sample>& samples);
+        static std::vector<Sample> mean(const std::vector<std::vector<Sample>>& samplesList);
         
         static std::vector<Sample> meanUniqueLocations(std::vector<Sample> samples);
         
@@ -100,6 +101,65 @@ namespace loc{
         
     };
     
+    /**
+     Count, mean and sum of squared deviations of RSSI values of a beacon
+     **/
+    class RssiStatistics{
+    public:
+        int count = 0;
+        double mean = 0;
+        double m2 = 0;
+        
+        void add(double rssi);
+        void merge(const RssiStatistics& stats);
+        // sum of (rssi - ypred)^2
+        double squareErrorSum(double ypred) const;
+    };
+    
+    /**
+     Consecutive samples at the same location
+     **/
+    class AggregatedSample{
+    public:
+        Location location;
+        long timestampSum = 0;
+        int count = 0;
+        std::vector<std::pair<BeaconId, RssiStatistics>> beaconStatistics; // sorted by beacon id
+        
+        void add(const Sample& sample);
+        void merge(const AggregatedSample& aggregatedSample);
+        // equivalent to Sample::mean of the aggregated samples
+        Sample mean() const;
+    };
+    
+    /**
+     Aggregates samples on the fly so that raw samples need not be kept for training.
+     Consecutive samples at the same location are grouped as Sample::splitSamplesToConsecutiveSamples.
+     **/
+    class SampleAggregator{
+    private:
+        std::vector<AggregatedSample> aggregatedSamples_;
+        size_t nSamples_ = 0;
+        
+    public:
+        SampleAggregator& add(const Sample& sample);
+        SampleAggregator& add(const Samples& samples);
+        void clear();
+        
+        // number of raw samples
+        size_t nSamples() const;
+        const std::vector<AggregatedSample>& aggregatedSamples() const;
+        // equivalent to Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)) unless filtered (see below)
+        std::vector<Sample> meanSamples() const;
+        std::vector<Location> extractUniqueLocations() const;
+        
+        // Drops statistics of unregistered beacons and groups left without beacons.
+        // Unlike Sample::filterUnregisteredBeacons, samples which had only unregistered beacons in a kept group
+        // are not removed because beacon sets of individual samples are not kept. They still count toward
+        // nSamples() and the mean timestamp of the group while mean RSSIs are not affected.
+        SampleAggregator filterUnregisteredBeacons(const BLEBeacons& bleBeacons) const;
+    };
+    
     
     
 }
@@ -22,7 +22,10 @@
 
 #include <stdio.h>
 
+#include <numeric>
+
 #include "State.hpp"
+#include "LocException.hpp"
 
 
 namespace  loc {
@@ -149,6 +152,231 @@ namespace  loc {
     }
     
     
+    // StatesSoA
+    StatesSoA::StatesSoA(const States& states){
+        assign(states);
+    }
+    
+    size_t StatesSoA::size() const{
+        return x.size();
+    }
+    
+    bool StatesSoA::empty() const{
+        return x.empty();
+    }
+    
+    void StatesSoA::resize(size_t n){
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+        floor.resize(n);
+        orientation.resize(n);
+        velocity.resize(n);
+        normalVelocity.resize(n);
+        orientationBias.resize(n);
+        orientationAlignment.resize(n);
+        rssiBias.resize(n);
+        weight.resize(n, 1.0);
+        negativeLogLikelihood.resize(n);
+        mahalanobisDistance.resize(n);
+        timestamp.resize(n);
+        history.resize(n);
+    }
+    
+    void StatesSoA::clear(){
+        resize(0);
+    }
+    
+    void StatesSoA::assign(const States& states){
+        size_t n = states.size();
+        resize(n);
+        for(size_t i=0; i<n; i++){
+            const State& s = states[i];
+            set(i, s);
+            timestamp[i] = s.timestamp;
+            history[i] = s.history;
+        }
+    }
+    
+    void StatesSoA::assign(States&& states){
+        size_t n = states.size();
+        resize(n);
+        for(size_t i=0; i<n; i++){
+            State& s = states[i];
+            set(i, s);
+            timestamp[i] = s.timestamp;
+            history[i] = std::move(s.history);
+        }
+        states.clear();
+    }
+    
+    State StatesSoA::at(size_t i) const{
+        State s;
+        s.x(x[i]).y(y[i]).z(z[i]).floor(floor[i]);
+        s.orientation(orientation[i]).velocity(velocity[i]).normalVelocity(normalVelocity[i]);
+        s.orientationBias(orientationBias[i]).orientationAlignment(orientationAlignment[i]).rssiBias(rssiBias[i]);
+        s.weight(weight[i]).negativeLogLikelihood(negativeLogLikelihood[i]).mahalanobisDistance(mahalanobisDistance[i]);
+        s.timestamp = timestamp[i];
+        return s;
+    }
+    
+    Location StatesSoA::locationAt(size_t i) const{
+        return Location(x[i], y[i], z[i], floor[i]);
+    }
+    
+    void StatesSoA::set(size_t i, const State& s){
+        x[i] = s.x();
+        y[i] = s.y();
+        z[i] = s.z();
+        floor[i] = s.floor();
+        orientation[i] = s.orientation();
+        velocity[i] = s.velocity();
+        normalVelocity[i] = s.normalVelocity();
+        orientationBias[i] = s.orientationBias();
+        orientationAlignment[i] = s.orientationAlignment();
+        rssiBias[i] = s.rssiBias();
+        weight[i] = s.weight();
+        negativeLogLikelihood[i] = s.negativeLogLikelihood();
+        mahalanobisDistance[i] = s.mahalanobisDistance();
+    }
+    
+    void StatesSoA::copyLocation(size_t i, const Location& location){
+        x[i] = location.x();
+        y[i] = location.y();
+        z[i] = location.z();
+        floor[i] = location.floor();
+    }
+    
+    States StatesSoA::toStates(bool withHistory) const{
+        size_t n = size();
+        States states(n);
+        for(size_t i=0; i<n; i++){
+            states[i] = at(i);
+            if(withHistory){
+                states[i].history = history[i];
+            }
+        }
+        return states;
+    }
+    
+    StatesSoA StatesSoA::snapshot() const{
+        StatesSoA copy;
+        copy.x = x;
+        copy.y = y;
+        copy.z = z;
+        copy.floor = floor;
+        copy.orientation = orientation;
+        copy.velocity = velocity;
+        copy.normalVelocity = normalVelocity;
+        copy.orientationBias = orientationBias;
+        copy.orientationAlignment = orientationAlignment;
+        copy.rssiBias = rssiBias;
+        copy.weight = weight;
+        copy.negativeLogLikelihood = negativeLogLikelihood;
+        copy.mahalanobisDistance = mahalanobisDistance;
+        copy.timestamp = timestamp;
+        copy.history.resize(size());
+        return copy;
+    }
+    
+    States StatesSoA::releaseStates(){
+        size_t n = size();
+        States states(n);
+        for(size_t i=0; i<n; i++){
+            states[i] = at(i);
+            states[i].history = std::move(history[i]);
+        }
+        return states;
+    }
+    
+    void StatesSoA::restoreHistories(States& states){
+        size_t n = size();
+        if(states.size() != n){
+            BOOST_THROW_EXCEPTION(LocException("states.size() != StatesSoA::size()"));
+        }
+        for(size_t i=0; i<n; i++){
+            history[i] = std::move(states[i].history);
+        }
+    }
+    
+    Locations StatesSoA::toLocations() const{
+        size_t n = size();
+        Locations locations(n);
+        for(size_t i=0; i<n; i++){
+            locations[i] = locationAt(i);
+        }
+        return locations;
+    }
+    
+    template<class T>
+    static void gatherColumn(std::vector<T>& column, const std::vector<int>& indices){
+        std::vector<T> gathered(indices.size());
+        for(size_t k=0; k<indices.size(); k++){
+            gathered[k] = column[indices[k]];
+        }
+        column.swap(gathered);
+    }
+    
+    void StatesSoA::gather(const std::vector<int>& indices){
+        gatherColumn(x, indices);
+        gatherColumn(y, indices);
+        gatherColumn(z, indices);
+        gatherColumn(floor, indices);
+        gatherColumn(orientation, indices);
+        gatherColumn(velocity, indices);
+        gatherColumn(normalVelocity, indices);
+        gatherColumn(orientationBias, indices);
+        gatherColumn(orientationAlignment, indices);
+        gatherColumn(rssiBias, indices);
+        gatherColumn(weight, indices);
+        gatherColumn(negativeLogLikelihood, indices);
+        gatherColumn(mahalanobisDistance, indices);
+        gatherColumn(timestamp, indices);
+        gatherColumn(history, indices);
+    }
+    
+    double StatesSoA::sumWeights() const{
+        return std::accumulate(weight.begin(), weight.end(), 0.0);
+    }
+    
+    // Same computation as State::weightedMean
+    State StatesSoA::weightedMean() const{
+        size_t n = size();
+        double weightSum = sumWeights();
+        
+        double xm = 0, ym = 0, zm = 0, floorm = 0;
+        double vxm = 0, vym = 0;
+        double vxrepm = 0, vyrepm = 0;
+        double meanRssiBias = 0;
+        double xOri = 0;
+        double yOri = 0;
+        for(size_t i=0; i<n; i++){
+            double w = weight[i]/weightSum;
+            double c = std::cos(orientation[i]);
+            double s = std::sin(orientation[i]);
+            xm += w * x[i];
+            ym += w * y[i];
+            zm += w * z[i];
+            floorm += w * floor[i];
+            vxm += w * velocity[i] * c;
+            vym += w * velocity[i] * s;
+            vxrepm += w * normalVelocity[i] * c;
+            vyrepm += w * normalVelocity[i] * s;
+            meanRssiBias += rssiBias[i]*w;
+            xOri += std::cos(orientationBias[i]*w);
+            yOri += std::sin(orientationBias[i]*w);
+        }
+        State meanState;
+        meanState.x(xm).y(ym).z(zm).floor(floorm);
+        meanState.orientation(atan2(vyrepm, vxrepm))
+                 .velocity(std::sqrt(vxm*vxm + vym*vym))
+                 .normalVelocity(std::sqrt(vxrepm*vxrepm + vyrepm*vyrepm));
+        meanState.rssiBias(meanRssiBias);
+        meanState.orientationBias(std::atan2(yOri, xOri));
+        return meanState;
+    }
+    
+    
     // State Property
     StateProperty& StateProperty::meanRssiBias(double meanRssiBias){
         meanRssiBias_ = meanRssiBias;
@@ -76,7 +76,70 @@ namespace loc{
         boost::circular_buffer<State> history;
         static size_t history_capacity;
     };
-    
+
+    /**
+     Structure-of-arrays container of particles.
+     Each member of State is stored in its own contiguous array so that
+     per-step operations (prediction, likelihood evaluation, resampling)
+     do not copy whole State objects. History buffers are kept in a separate
+     column and are never copied by at() and set().
+     **/
+    class StatesSoA{
+    public:
+        using Ptr = std::shared_ptr<StatesSoA>;
+
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+        std::vector<double> floor;
+        std::vector<double> orientation;
+        std::vector<double> velocity;
+        std::vector<double> normalVelocity;
+        std::vector<double> orientationBias;
+        std::vector<double> orientationAlignment;
+        std::vector<double> rssiBias;
+        std::vector<double> weight;
+        std::vector<double> negativeLogLikelihood;
+        std::vector<double> mahalanobisDistance;
+        std::vector<long> timestamp;
+        std::vector<boost::circular_buffer<State>> history;
+
+        StatesSoA() = default;
+        ~StatesSoA() = default;
+        explicit StatesSoA(const States& states);
+
+        size_t size() const;
+        bool empty() const;
+        void resize(size_t n);
+        void clear();
+
+        void assign(const States& states);
+        void assign(States&& states);
+
+        // State at index i without history
+        State at(size_t i) const;
+        // Location at index i
+        Location locationAt(size_t i) const;
+        // Overwrite particle i except for its timestamp and history
+        void set(size_t i, const State& state);
+        void copyLocation(size_t i, const Location& location);
+
+        States toStates(bool withHistory = true) const;
+        // Copy of the particles with empty histories
+        StatesSoA snapshot() const;
+        // Move particles out with their histories. The history column is left empty.
+        States releaseStates();
+        // Move histories back from states returned by releaseStates()
+        void restoreHistories(States& states);
+        Locations toLocations() const;
+
+        // Replace particles by particles[indices[k]] (e.g. resampling)
+        void gather(const std::vector<int>& indices);
+
+        double sumWeights() const;
+        State weightedMean() const;
+    };
+
     class StateProperty{
         
         double meanRssiBias_ = 0.0; // [dBm/s]
@@ -23,6 +23,8 @@
 #include "Status.hpp"
 #include "Location.hpp"
 
+#include <atomic>
+
 namespace loc{
     
     Status::Status() : states_(new std::vector<State>()){
@@ -31,22 +33,7 @@ namespace loc{
     Status::~Status(){}
     
     Status::Status(const Status& status){
-        step_ = status.step_;
-        locationStatus_ = status.locationStatus_;
-        timestamp_ = status.timestamp_;
-        mWasFloorUpdated = status.mWasFloorUpdated;
-        auto meanLoc = status.meanLocation();
-        auto meanPose = status.meanPose();
-        auto states = status.states();
-        if(meanLoc){
-            meanLocation_ = Location::Ptr(new Location(*meanLoc));
-        }
-        if(meanPose){
-            meanPose_ = Pose::Ptr(new Pose(*meanPose));
-        }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
-        }
+        *this = status;
     }
     
     Status& Status::operator=(const Status& status){
@@ -54,17 +41,17 @@ namespace loc{
         locationStatus_ = status.locationStatus_;
         timestamp_ = status.timestamp_;
         mWasFloorUpdated = status.mWasFloorUpdated;
-        auto meanLoc = status.meanLocation();
-        auto meanPose = status.meanPose();
-        auto states = status.states();
-        if(meanLoc){
-            meanLocation_ = Location::Ptr(new Location(*meanLoc));
+        // Mean values and particles are never modified in place by Status, so they are shared.
+        if(status.meanLocation_){
+            meanLocation_ = status.meanLocation_;
         }
-        if(meanPose){
-            meanPose_ = Pose::Ptr(new Pose(*meanPose));
+        if(status.meanPose_){
+            meanPose_ = status.meanPose_;
         }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
+        auto states = std::atomic_load(&status.states_);
+        if(states || status.particles_){
+            std::atomic_store(&states_, states);
+            particles_ = status.particles_;
         }
         return *this;
     }
@@ -81,8 +68,14 @@ namespace loc{
         return timestamp_;
     }
     
-    std::shared_ptr<std::vector<State>> Status::states() const{
-        return states_;
+    std::shared_ptr<const std::vector<State>> Status::states() const{
+        auto states = std::atomic_load(&states_);
+        if(!states && particles_){
+            // State histories are internal to the filter and are not published.
+            states = std::make_shared<const States>(particles_->toStates(false));
+            std::atomic_store(&states_, states);
+        }
+        return states;
     }
     
     Status& Status::meanLocation(std::shared_ptr<Location> location){
@@ -106,10 +99,11 @@ namespace loc{
         return this->states(statesTmp);
     }
     
-    Status& Status::states(std::shared_ptr<std::vector<State>> states){
+    Status& Status::states(std::shared_ptr<const std::vector<State>> states){
         this->step(Status::OTHER);
         
-        states_ = states;
+        std::atomic_store(&states_, states);
+        particles_.reset();
         size_t n = states->size();
         std::vector<double> weights(n);
         for(int i=0; i<n; i++){
@@ -123,12 +117,26 @@ namespace loc{
         return *this;
     }
     
-    Status& Status::states(std::shared_ptr<std::vector<State>> states, Step step){
+    Status& Status::states(std::shared_ptr<const std::vector<State>> states, Step step){
         this->states(states);
         this->step(step);
         return *this;
     }
     
+    Status& Status::particles(std::shared_ptr<const StatesSoA> particles, Step step){
+        this->step(Status::OTHER);
+        
+        std::atomic_store(&states_, std::shared_ptr<const std::vector<State>>());
+        particles_ = particles;
+        // StatesSoA::weightedMean computes the same means as Location::weightedMean and Pose::weightedMean
+        State meanState = particles->weightedMean();
+        meanLocation(std::make_shared<Location>(meanState.x(), meanState.y(), meanState.z(), meanState.floor()));
+        meanPose(std::make_shared<Pose>(meanState));
+        
+        this->step(step);
+        return *this;
+    }
+    
     Status::Step Status::step() const{
         return step_;
     }
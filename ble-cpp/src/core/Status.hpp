@@ -39,7 +39,7 @@ namespace loc{
         Status();
         ~Status();
         
-        // copy constructor
+        // Copies share particles and mean values with the source (O(1)). Shared particles are read-only.
         Status(const Status& s);
         Status& operator=(const Status& s);
         
@@ -63,7 +63,7 @@ namespace loc{
         std::shared_ptr<Location> meanLocation() const;
         std::shared_ptr<Pose> meanPose() const;
         long timestamp() const;
-        std::shared_ptr<std::vector<State>> states() const;
+        std::shared_ptr<const std::vector<State>> states() const;
         Step step() const;
         LocationStatus locationStatus() const;
         
@@ -72,8 +72,10 @@ namespace loc{
         [[deprecated("please use states(std::shared_ptr<std::vector<State>>) function")]]
         Status& states(std::vector<State>* states);
         
-        Status& states(std::shared_ptr<std::vector<State>> states);
-        Status& states(std::shared_ptr<std::vector<State>> states, Step step);
+        Status& states(std::shared_ptr<const std::vector<State>> states);
+        Status& states(std::shared_ptr<const std::vector<State>> states, Step step);
+        // Mean values are computed from the particles. states() is produced from them when it is first read.
+        Status& particles(std::shared_ptr<const StatesSoA> particles, Step step);
         Status& step(Step step);
         Status& locationStatus(LocationStatus locationStatus);
         
@@ -93,7 +95,9 @@ namespace loc{
         //LocationStatus locationStatus_ = UNKNOWN;
         std::shared_ptr<Location> meanLocation_;
         std::shared_ptr<Pose> meanPose_;
-        std::shared_ptr<std::vector<State>> states_;
+        // states_ is materialized from particles_ on demand (accessed atomically)
+        mutable std::shared_ptr<const std::vector<State>> states_;
+        std::shared_ptr<const StatesSoA> particles_;
         bool mWasFloorUpdated = false;
         
         Status& meanLocation(std::shared_ptr<Location> location);
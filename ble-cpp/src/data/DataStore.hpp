@@ -42,6 +42,10 @@ public:
     
     virtual ~DataStore() = default;
     virtual const Samples& getSamples() const = 0;
+    // samples aggregated on ingestion instead of stored (nullptr: not aggregated)
+    virtual const SampleAggregator* getSampleAggregator() const{
+        return nullptr;
+    }
     virtual const BLEBeacons& getBLEBeacons() const = 0;
     
     virtual const Building& getBuilding() const = 0;
@@ -30,7 +30,11 @@ namespace loc{
     DataStoreImpl& building(Building building);
     
     void DataStoreImpl::readSamples(std::istream &is){
-        DataUtils::csvSamplesToSamples(is, mSamples);
+        if(mAggregatesSamples){
+            DataUtils::csvSamplesToSamples(is, mSampleAggregator);
+        }else{
+            DataUtils::csvSamplesToSamples(is, mSamples);
+        }
     }
     void DataStoreImpl::readSamples(std::istream &is, bool noBeacons){
         DataUtils::csvSamplesToSamples(is, mSamples, noBeacons);
@@ -55,10 +59,19 @@ namespace loc{
         return *this;
     }
     
+    DataStoreImpl& DataStoreImpl::aggregatesSamples(bool aggregates){
+        mAggregatesSamples = aggregates;
+        return *this;
+    }
+    
     const Samples& DataStoreImpl::getSamples() const{
         return mSamples;
     }
     
+    const SampleAggregator* DataStoreImpl::getSampleAggregator() const{
+        return mAggregatesSamples ? &mSampleAggregator : nullptr;
+    }
+    
     const BLEBeacons& DataStoreImpl::getBLEBeacons() const{
         return mBLEBeacons;
     }
@@ -69,7 +82,11 @@ namespace loc{
     
     const Locations& DataStoreImpl::getLocations() const{
         if(mLocations.size()==0){
-            mLocations = Sample::extractUniqueLocations(mSamples);
+            if(mAggregatesSamples){
+                mLocations = mSampleAggregator.extractUniqueLocations();
+            }else{
+                mLocations = Sample::extractUniqueLocations(mSamples);
+            }
         }
         return mLocations;
     }
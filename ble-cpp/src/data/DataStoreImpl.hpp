@@ -38,6 +38,8 @@ namespace loc{
         
     private:
         Samples mSamples;
+        bool mAggregatesSamples = false;
+        SampleAggregator mSampleAggregator;
         BLEBeacons mBLEBeacons;
         Building mBuilding;
         mutable Locations mLocations;
@@ -52,10 +54,13 @@ namespace loc{
         DataStoreImpl& bleBeacons(BLEBeacons bleBeacons);
         DataStoreImpl& building(Building building);
         DataStoreImpl& locations(Locations locations);
+        // samples read after this call are aggregated for training instead of stored
+        DataStoreImpl& aggregatesSamples(bool aggregates);
         
         void readSamples(std::istream &is);
         void readSamples(std::istream &is, bool noBeacons);
         const Samples& getSamples() const override;
+        const SampleAggregator* getSampleAggregator() const override;
         const BLEBeacons& getBLEBeacons() const override;
         
         const Building& getBuilding() const override;
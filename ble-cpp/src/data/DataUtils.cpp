@@ -494,6 +494,17 @@ namespace loc{
         return std::move(samples);
     }
     
+    void DataUtils::csvSamplesToSamples(std::istream& istream, SampleAggregator& aggregator){
+        std::string strBuffer;
+        while(std::getline(istream, strBuffer)){
+            try{
+                aggregator.add(parseSampleCSV(strBuffer, false));
+            } catch (std::invalid_argument e){
+                std::cout << "Invalid csv line was found. line=" <<strBuffer << std::endl;
+            }
+        }
+    }
+    
     Sample DataUtils::parseShortSampleCSV(const std::string& csvLine) throw(std::invalid_argument) {
         //Location location = parseLocationCSV(csvLine);
         //Beacons beacons = parseBeaconsCSV(csvLine);
@@ -705,7 +716,7 @@ namespace loc{
     picojson::object DataUtils::statusToJSONObject(Status status, bool optOutputStates){
         std::shared_ptr<Location> meanLocation = status.meanLocation();
         std::shared_ptr<Pose> meanPose = status.meanPose();
-        std::shared_ptr<std::vector<State>> states = status.states();
+        std::shared_ptr<const std::vector<State>> states = status.states();
         Location stdevLocation = Location::standardDeviation(*states);
         
         picojson::object json;
@@ -94,6 +94,8 @@ namespace loc{
         static void csvSamplesToSamples(std::istream& istream, Samples &Samples, bool noBeacons);
         static Samples csvSamplesToSamples(std::istream& istream);
         static Samples csvSamplesToSamples(std::istream& istream, bool noBeacons);
+        // aggregate samples line by line without storing them
+        static void csvSamplesToSamples(std::istream& istream, SampleAggregator& aggregator);
         static Sample parseShortSampleCSV(const std::string& csvLine)  throw (std::invalid_argument);
         static void shortCsvSamplesToSamples(std::istream& istream, Samples &Samples);
         static Samples shortCsvSamplesToSamples(std::istream& istream);
@@ -135,7 +135,7 @@ namespace loc{
                         sstream << locTrue << "," << *poseEst << std::endl;
                         if(savesStates){
                             std::stringstream ss;
-                            std::shared_ptr<std::vector<State>> states = status->states();
+                            std::shared_ptr<const std::vector<State>> states = status->states();
                             for(State state: *states){
                                 ss << state << std::endl;
                             }
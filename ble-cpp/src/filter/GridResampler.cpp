@@ -29,8 +29,20 @@ namespace loc{
     
     template<class Tstate> std::vector<Tstate>* GridResampler<Tstate>::resample(const std::vector<Tstate>& states, const double weights[]){
         
-        int n = (int) states.size();
+        std::vector<int> indices = resampleIndices(weights, states.size());
         std::vector<Tstate>* statesResampled = new std::vector<Tstate>();
+        statesResampled->reserve(indices.size());
+        for(int i: indices){
+            statesResampled->push_back(states.at(i));
+        }
+        return statesResampled;
+    }
+    
+    template<class Tstate> std::vector<int> GridResampler<Tstate>::resampleIndices(const double weights[], size_t nStates){
+        
+        int n = (int) nStates;
+        std::vector<int> indices;
+        indices.reserve(n);
         
         double d = rand.nextDouble();
         std::vector<double> grid(n);
@@ -45,22 +57,19 @@ namespace loc{
         double cumWeight=0;
         int k=0;
         for(int i=0; i<n; i++){
-            int numSample = 0;
             cumWeight += weights[i];
             if(i==n-1){
                 cumWeight = 1.0;
             }
             for( ; k<n; k++){
                 if(grid[k] < cumWeight){
-                    Tstate stateCopied(states.at(i));
-                    statesResampled->push_back(stateCopied);
-                    numSample++;
+                    indices.push_back(i);
                 }else{
                     break;
                 }
             }
         }
-        return statesResampled;
+        return indices;
     }
     
     // Explicit instantiation
@@ -36,6 +36,7 @@ namespace loc{
         ~GridResampler(){}
         
         std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]);
+        std::vector<int> resampleIndices(const double weights[], size_t n);
     
     private:
         enum GridType{SYSTEMATIC, STRATIFIED};
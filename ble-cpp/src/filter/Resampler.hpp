@@ -32,6 +32,8 @@ namespace loc{
     public:
         virtual ~Resampler(){}
         virtual std::vector<Tstate>* resample(const std::vector<Tstate> & states, const double weights[]) = 0;
+        // Returns the indices of the particles to be kept (e.g. to be applied to StatesSoA::gather)
+        virtual std::vector<int> resampleIndices(const double weights[], size_t n) = 0;
     };
     
 }
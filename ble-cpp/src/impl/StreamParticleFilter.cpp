@@ -101,7 +101,7 @@ namespace loc{
         RandomGenerator::Ptr randomGenerator;
         bool mVerbose = false;
         
-        void floorUpdate(States& states, const Beacons& beacons){
+        void floorUpdate(StatesSoA& states, const Beacons& beacons){
             const BLEBeacons& bleBeacons = mDataStore->getBLEBeacons();
             auto knownBeacons = BLEBeacon::filter(beacons, bleBeacons);
             
@@ -135,7 +135,7 @@ namespace loc{
             return obsFloors;
         }
         
-        void floorUpdateSimple(States& states, const Beacons& beacons){
+        void floorUpdateSimple(StatesSoA& states, const Beacons& beacons){
             if(beacons.size()==0){
                 return;
             }
@@ -159,19 +159,28 @@ namespace loc{
                 }
             }
             // Update floor when repFloor is different from state.floor
-            for(auto& s: states){
-                int floor = std::round(s.floor());
+            bool updatesFloor = false;
+            for(size_t i=0; i<states.size(); i++){
+                int floor = std::round(states.floor[i]);
                 if(obsFloors.count(floor) == 0){
-                    State sTmp(s);
-                    sTmp.floor(repFloor);
-                    if(building.isMovable(sTmp)){
-                        s.floor(repFloor);
-                    }
+                    updatesFloor = true;
+                    break;
+                }
+            }
+            if(!updatesFloor){
+                return;
+            }
+            std::vector<bool> movable;
+            building.isMovable(repFloor, states.x.data(), states.y.data(), states.size(), movable);
+            for(size_t i=0; i<states.size(); i++){
+                int floor = std::round(states.floor[i]);
+                if(obsFloors.count(floor) == 0 && movable[i]){
+                    states.floor[i] = repFloor;
                 }
             }
         }
         
-        void floorUpdateUsingObservationModel(States& states, const Beacons& beacons){
+        void floorUpdateUsingObservationModel(StatesSoA& states, const Beacons& beacons){
             if(beacons.size()==0){
                 return;
             }
@@ -185,7 +194,7 @@ namespace loc{
             // Add floors
             std::map<int, int> obsFloors = countFloors(beacons, bleBeacons);
 
-            State meanState = State::weightedMean(states);
+            State meanState = states.weightedMean();
             std::vector<int> floors;
             States statesTmp;
             for(auto iter = obsFloors.begin(); iter!=obsFloors.end(); iter++){
@@ -228,15 +237,14 @@ namespace loc{
             // update floors
             std::vector<int> floorsWritten(states.size());
             for(int i=0; i<states.size(); i++){
-                auto&s = states.at(i);
-                int floor = std::round(s.floor());
+                int floor = std::round(states.floor[i]);
                 int floorGen = floorsGenerated.at(i);
                 floorsWritten.at(i) = floor;
                 if(floor!=floorGen){
-                    State sTmp(s);
-                    sTmp.floor(floorGen);
-                    if(building.isMovable(sTmp)){
-                        s.floor(floorGen);
+                    Location locTmp = states.locationAt(i);
+                    locTmp.floor(floorGen);
+                    if(building.isMovable(locTmp)){
+                        states.floor[i] = floorGen;
                         floorsWritten.at(i) = floorGen;
                     }
                 }
@@ -289,6 +297,8 @@ namespace loc{
         std::queue<std::function<void()>> functionsForReset;
 
         std::shared_ptr<Status> status;
+        // Working particles. Status holds their snapshots and produces States on demand.
+        StatesSoA mParticles;
 
         std::shared_ptr<Pedometer> mPedometer;
         std::shared_ptr<OrientationMeter> mOrientationmeter;
@@ -297,6 +307,7 @@ namespace loc{
         std::shared_ptr<SystemModel<State, SystemModelInput>> mRandomWalker;
 
         std::shared_ptr<ObservationModel<State, Beacons>> mObservationModel;
+        std::shared_ptr<ObservationModelSoA<Beacons>> mObservationModelSoA;
         std::shared_ptr<Resampler<State>> mResampler;
         std::shared_ptr<StatusInitializer> mStatusInitializer;
         std::shared_ptr<BeaconFilter> mBeaconFilter;
@@ -333,10 +344,20 @@ namespace loc{
         ~Impl(){}
 
         void initializeStatusIfZero(){
-            if(status->states()->size()==0) {
+            if(mParticles.empty()) {
                 initializeStatus();
             }
         }
+        
+        void setParticles(const StatesPtr& states, Status::Step step){
+            mParticles.assign(*states);
+            status->states(states, step);
+        }
+        
+        void publishParticles(Status::Step step){
+            // States are produced from the snapshot only when status->states() is read.
+            status->particles(std::make_shared<const StatesSoA>(mParticles.snapshot()), step);
+        }
 
         void putAcceleration(const Acceleration acceleration){
             initializeStatusIfZero();
@@ -374,28 +395,15 @@ namespace loc{
             input.timestamp(timestamp);
             input.previousTimestamp(previousTimestampMotion);
 
-            std::shared_ptr<States> states = status->states();
-            
             bool timestampIntervalIsValid = (input.timestamp() - input.previousTimestamp()) < timestampIntervalLimit;
             
             if(timestampIntervalIsValid){
-                auto& statesObj = *states.get();
-                // move state history
-                std::vector<boost::circular_buffer<State>> histories(statesObj.size());
-                for(int i=0; i<statesObj.size(); i++){
-                    State& sPre = statesObj.at(i);
-                    histories[i] = std::move(sPre.history);
-                }
-                StatesPtr statesPredicted(new States(mRandomWalker->predict(statesObj, input)));
-                // move state history
-                for(int i=0; i<statesObj.size(); i++){
-                    State& sPre = statesObj.at(i);
-                    State& sNow = statesPredicted->at(i);
-                    sPre.timestamp = previousTimestampMotion;
-                    sNow.timestamp = timestamp;
-                    sNow.history = std::move(histories[i]);
-                }
-                status->states(statesPredicted, Status::PREDICTION);
+                // state histories are moved (not copied) through the system model.
+                States statesPredicted = mParticles.releaseStates();
+                mRandomWalker->predictInPlace(statesPredicted, input);
+                mParticles.assign(std::move(statesPredicted));
+                std::fill(mParticles.timestamp.begin(), mParticles.timestamp.end(), timestamp);
+                publishParticles(Status::PREDICTION);
             }else{
                 std::cout << "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used." << std::endl;
             }
@@ -426,41 +434,37 @@ namespace loc{
                 }
                 // Update states with the altimeter manager.
                 long ts = altimeter.timestamp();
-                std::shared_ptr<States> states = status->states();
-                auto statesNew = this->predictFloorTransState(states);
+                this->predictFloorTransState(mParticles);
                 status->timestamp(ts);
-                status->states(statesNew);
+                publishParticles(Status::OTHER);
                 callback(status.get());
             }
         }
         
-        StatesPtr predictFloorTransState(const StatesPtr& states){
+        void predictFloorTransState(StatesSoA& states){
             auto heightChanged = mAltitudeManager->heightChange();
             const auto& building = mDataStore->getBuilding();
             
-            auto statesNew = StatesPtr(new States(*states));
-            
             if(heightChanged > mFloorTransParams->heightChangedCriterion()){
                 // multiply weight by coeff in transition area.
                 size_t nTrans = 0;
-                size_t n = statesNew->size();
+                size_t n = states.size();
                 double coeff = mFloorTransParams->weightTransitionArea();
                 double sumWeights = 0.0;
-                for(auto& s: *statesNew){
-                    if(building.isTransitionArea(s)){
-                        s.weight(s.weight() * coeff);
+                for(size_t i=0; i<n; i++){
+                    if(building.isTransitionArea(states.locationAt(i))){
+                        states.weight[i] *= coeff;
                         nTrans++;
                     }
-                    sumWeights += s.weight();
+                    sumWeights += states.weight[i];
                 }
                 if(sumWeights<=0){
                     LocException ex("sum(weights) <= 0");
                     BOOST_THROW_EXCEPTION(ex);
                 }
                 // normalize weights
-                for(auto&s: *statesNew){
-                    double w = s.weight()/sumWeights;
-                    s.weight(w);
+                for(auto& w: states.weight){
+                    w /= sumWeights;
                 }
                 
                 // mix for floor transition area
@@ -468,7 +472,8 @@ namespace loc{
                 int nMixed = 0;
                 if(ratioTrans < mFloorTransParams->mixtureProbaTransArea()){
                     double ratioResid = mFloorTransParams->mixtureProbaTransArea() - ratioTrans;
-                    for(auto& s: *statesNew){
+                    for(size_t i=0; i<n; i++){
+                        Location s = states.locationAt(i);
                         if(building.isTransitionArea(s)){
                             continue;
                         }
@@ -483,7 +488,7 @@ namespace loc{
                             if( mFloorTransParams->rejectDistance() <= Location::distance(s, locTA)){
                                 continue;
                             }else{
-                                s.copyLocation(locTA);
+                                states.copyLocation(i, locTA);
                                 nMixed++;
                             }
                         }
@@ -499,12 +504,11 @@ namespace loc{
                     std::cout << ss.str() << std::endl;
                 }
             }
-            return statesNew;
         }
 
-        void logStates(const States& states, const std::string& filename){
+        void logStates(const StatesSoA& states, const std::string& filename){
             if(DataLogger::getInstance()){
-                DataLogger::getInstance()->log(filename, DataUtils::statesToCSV(states));
+                DataLogger::getInstance()->log(filename, DataUtils::statesToCSV(states.toStates(false)));
             }
         }
         
@@ -531,11 +535,12 @@ namespace loc{
             return statesGen;
         }
         
-        States mixStates(const States& states, const Beacons& beacons, const MixtureParameters& mixParams, bool evaluatesLLs,
+        // Mixed locations are written to states only when appliesMix is true.
+        void mixStates(StatesSoA& states, const Beacons& beacons, const MixtureParameters& mixParams, bool evaluatesLLs, bool appliesMix,
                        std::vector<State>& allGeneratedStates, std::vector<double>& allGeneratedStatesLogLLs
                        ){
             if( beacons.size() < mixParams.nBeaconsMinimum){
-                return states;
+                return;
             }
             size_t nStates = states.size();
             std::vector<int> indices;
@@ -550,25 +555,27 @@ namespace loc{
             
             //// do burn-in even if nGen==0 to evaluate likelihood
             if(nGen==0 && !evaluatesLLs){
-                return states;
+                return;
             }
             
             States statesGen = generateStatesForMix(nGen, beacons, mixParams, allGeneratedStates, allGeneratedStatesLogLLs);
+            if(nGen==0){
+                return;
+            }
             
-            States statesMixed(states);
+            // Generated states are compared with the states before mixing.
+            Locations locations = states.toLocations();
             //Location locMean = Location::mean(states);
             // Copy location of generated states to the existing states.
             for(int i=0; i<nGen; i++){
                 auto& st = statesGen.at(i);
                 //double p = computeStateAcceptProbability(locMean, st); //compate mean state and new state.
-                double p = computeStateAcceptProbability(states, st); //compare all states and new state.
-                if(mRand->nextDouble() < p ){
+                double p = computeStateAcceptProbability(locations, st); //compare all states and new state.
+                if(mRand->nextDouble() < p && appliesMix){
                     int idx = indices.at(i);
-                    statesMixed.at(idx).copyLocation(st);
+                    states.copyLocation(idx, st);
                 }
             }
-            
-            return statesMixed;
         }
         
         double computeStateAcceptProbability(const Location& locMean, const Location& locNew){
@@ -583,7 +590,7 @@ namespace loc{
             return 0;
         }
         
-        double computeStateAcceptProbability(const States& states, const Location& locNew){
+        double computeStateAcceptProbability(const Locations& states, const Location& locNew){
             size_t n = states.size();
             double sumDist = 0;
             double sumIsFloorDifferent = 0;
@@ -605,19 +612,33 @@ namespace loc{
         }
         
         void doFiltering(const Beacons& beacons){
-            this->updateStatusByBeacons(beacons, true, true);
+            auto step = this->updateStatusByBeacons(beacons, true, true);
+            publishParticles(step);
         }
         
-        void updateStatusByBeacons(const Beacons& beacons, const bool& doesFiltering, const bool& monitorsStatus){
+        std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(StatesSoA& states, const Beacons& beacons){
+            if(mObservationModelSoA){
+                return mObservationModelSoA->computeLogLikelihoodRelatedValues(states, beacons);
+            }else{
+                // Histories are lent to the observation model and moved back.
+                States statesTmp = states.releaseStates();
+                auto vals = mObservationModel->computeLogLikelihoodRelatedValues(statesTmp, beacons);
+                states.restoreHistories(statesTmp);
+                return vals;
+            }
+        }
+        
+        // Updates mParticles and returns the step to be published.
+        Status::Step updateStatusByBeacons(const Beacons& beacons, const bool& doesFiltering, const bool& monitorsStatus){
 
             if(beacons.size()==0){
-                return;
+                return Status::OTHER;
             }
 
             long timestamp = beacons.timestamp();
             
             status->timestamp(timestamp);
-            std::shared_ptr<States> states = status->states();
+            StatesSoA& states = mParticles;
             
             bool passedMonitoringInterval = false;
             if(timestamp - previousTimestampMonitoring > mLocStatusMonitorParams->monitorIntervalMS() ){
@@ -625,27 +646,24 @@ namespace loc{
                 previousTimestampMonitoring = timestamp;
             }
             
+            if(doesFiltering){
+                // Logging before weights updated
+                logStates(states, "before_likelihood_states_"+std::to_string(timestamp)+".csv");
+            }
+            
             // Compute states mixed with states generated from observations
+            // (Mixed states are applied only when filtering)
             std::vector<State> allMixStates;
             std::vector<double> allMixLogLLs;
-            States statesMixed;
             if(passedMonitoringInterval || mMixParams.mixtureProbability>0){
-                statesMixed = mixStates(*states, beacons, mMixParams, passedMonitoringInterval, allMixStates, allMixLogLLs);
-            }else{
-                statesMixed = *states;
-            }
-            if(doesFiltering){
-                // Logging before weights updated
-                logStates(*states, "before_likelihood_states_"+std::to_string(timestamp)+".csv");
-                // Copy mixed states when apply filtering
-                *states = statesMixed;
+                mixStates(states, beacons, mMixParams, passedMonitoringInterval, doesFiltering, allMixStates, allMixLogLLs);
             }
             
             // Compute log likelihood
-            std::vector<std::vector<double>> vLogLLsAndMDists = mObservationModel->computeLogLikelihoodRelatedValues(*states, beacons);
-            std::vector<double> vLogLLs(states->size());
-            std::vector<double> mDists(states->size());
-            for(int i=0; i<states->size(); i++){
+            std::vector<std::vector<double>> vLogLLsAndMDists = computeLogLikelihoodRelatedValues(states, beacons);
+            std::vector<double> vLogLLs(states.size());
+            std::vector<double> mDists(states.size());
+            for(int i=0; i<states.size(); i++){
                 vLogLLs[i] = vLogLLsAndMDists.at(i).at(0);
                 mDists[i] = vLogLLsAndMDists.at(i).at(1);
             }
@@ -715,16 +733,15 @@ namespace loc{
                 
                 // Set negative log-likelihoods
                 for(int i=0; i<vLogLLs.size(); i++){
-                    State& s = states->at(i);
-                    s.negativeLogLikelihood(-vLogLLs.at(i));
-                    s.mahalanobisDistance(mDists.at(i));
+                    states.negativeLogLikelihood[i] = -vLogLLs.at(i);
+                    states.mahalanobisDistance[i] = mDists.at(i);
                 }
                 
                 std::vector<double> weights = ArrayUtils::computeWeightsFromLogLikelihood(vLogLLs);
                 double sumWeights = 0;
                 // Multiply loglikelihood-based weights and particle weights.
                 for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i] * (states->at(i).weight());
+                    weights[i] = weights[i] * states.weight[i];
                     sumWeights += weights[i];
                 }
                 if(sumWeights<=0){
@@ -740,49 +757,46 @@ namespace loc{
                 // Renormalized
                 for(int i=0; i<weights.size(); i++){
                     weights[i] = weights[i]/sumWeights;
-                    states->at(i).weight(weights[i]);
+                    states.weight[i] = weights[i];
                 }
                 
                 // Logging after weights updated
-                logStates(*states, "after_likelihood_states_"+std::to_string(timestamp)+".csv");
+                logStates(states, "after_likelihood_states_"+std::to_string(timestamp)+".csv");
                 
                 // Resampling step
                 double ess = computeESS(weights);
                 if(mOptVerbose){
                     std::cout << "ESS=" << ess << std::endl;
                 }
-                StatesPtr statesNew;
                 Status::Step step;
                 
                 if(ess<=mEssThreshold){
-                    statesNew.reset(mResampler->resample(*states, &weights[0]));
+                    std::vector<int> indices = mResampler->resampleIndices(&weights[0], weights.size());
+                    states.gather(indices);
                     // Assign equal weights after resampling
-                    for(int i=0; i<weights.size(); i++){
-                        double weight = 1.0/(weights.size());
-                        statesNew->at(i).weight(weight);
-                    }
+                    double weight = 1.0/(weights.size());
+                    std::fill(states.weight.begin(), states.weight.end(), weight);
                     step = Status::FILTERING_WITH_RESAMPLING;
                 }else{
-                    statesNew.reset(new States(*states));
                     step = Status::FILTERING_WITHOUT_RESAMPLING;
                 }
                 
                 // Posterior-resampling
                 if(mPostResampler){
-                    *statesNew = mPostResampler->resample(*statesNew);
+                    states.assign(mPostResampler->resample(states.releaseStates()));
                 }
                 
-                status->states(statesNew, step);
                 if(mOptVerbose){
                     std::cout << "resampling at t=" << beacons.timestamp() << std::endl;
                 }
                 // Logging after resampling
-                logStates(*statesNew, "resampled_states_"+std::to_string(timestamp)+".csv");
+                logStates(states, "resampled_states_"+std::to_string(timestamp)+".csv");
                 
                 // Notify registered instances of the update of particle fiter
                 this->notifyObservationUpdated();
+                return step;
             }else{
-                return;
+                return Status::OBSERVATION_WITHOUT_FILTERING;
             }
         }
 
@@ -866,10 +880,10 @@ namespace loc{
             status->step(Status::OTHER);
             
             const Beacons& beaconsFiltered = filterBeacons(beacons);
+            Status::Step step = Status::OBSERVATION_WITHOUT_FILTERING;
+            bool tryFloorUpdate = false;
             if(beaconsFiltered.size()>0){
                 // Observation dependent floor update
-                std::shared_ptr<States> states = status->states();
-                bool tryFloorUpdate = false;
                 if(mEnablesFloorUpdate){
                     if(!mFloorUpdater){
                         mFloorUpdater.reset(new FloorUpdater);
@@ -881,53 +895,42 @@ namespace loc{
                     }
                     tryFloorUpdate = checkTryFloorUpdate();
                     if(tryFloorUpdate){
-                        mFloorUpdater->floorUpdate(*states, beaconsFiltered);
-                        status->states(states);// update states to compute rep values.
+                        mFloorUpdater->floorUpdate(mParticles, beaconsFiltered);
                     }
                 }
                 // filtering
-                bool doesFiltering = checkIfDoFiltering(*states);
+                bool doesFiltering = checkIfDoFiltering(mParticles);
                 bool monitorsStatus = true;
                 
+                step = updateStatusByBeacons(beaconsFiltered, doesFiltering, monitorsStatus);
                 if(doesFiltering){
-                    updateStatusByBeacons(beaconsFiltered, doesFiltering, monitorsStatus);
-                    assert( status->step()==Status::FILTERING_WITH_RESAMPLING
-                           || status->step()==Status::FILTERING_WITHOUT_RESAMPLING );
+                    assert( step==Status::FILTERING_WITH_RESAMPLING
+                           || step==Status::FILTERING_WITHOUT_RESAMPLING );
                 }else{
-                    updateStatusByBeacons(beaconsFiltered, doesFiltering, monitorsStatus);
                     if(mOptVerbose){
                         std::cout<<"filtering step was not applied."<<std::endl;
                     }
-                    status->step(Status::OBSERVATION_WITHOUT_FILTERING);
-                }
-                if(mEnablesFloorUpdate){
-                    if(tryFloorUpdate){
-                        status->wasFloorUpdated(true);
-                    }
                 }
-            }else{
-                status->step(Status::OBSERVATION_WITHOUT_FILTERING);
             }
             
             // manage state history
             {
                 auto timestamp = beacons.timestamp();
-                std::shared_ptr<States> states = status->states();
-                auto& statesObj = *states.get();
-                // move state history
-                for(int i=0; i<statesObj.size(); i++){
-                    State& sNow = statesObj.at(i);
-                    sNow.timestamp = timestamp;
-                    if(sNow.history.empty()){
-                        sNow.history.set_capacity(State::history_capacity);
+                for(int i=0; i<mParticles.size(); i++){
+                    mParticles.timestamp[i] = timestamp;
+                    auto& history = mParticles.history[i];
+                    if(history.empty()){
+                        history.set_capacity(State::history_capacity);
                     }
-                    auto history = std::move(sNow.history);
-                    history.push_back(sNow);
-                    sNow.history = std::move(history);
+                    history.push_back(mParticles.at(i));
                 }
             }
             
             status->timestamp(beacons.timestamp());
+            publishParticles(step);
+            if(tryFloorUpdate){
+                status->wasFloorUpdated(true);
+            }
             callback(status.get());
         };
 
@@ -956,6 +959,7 @@ namespace loc{
             Status *st = new Status();
             st->states(states, Status::OTHER);
             status.reset(st);
+            mParticles.assign(*states);
         }
 
         void updateHandler(void (*functionCalledAfterUpdate)(Status*)){
@@ -995,7 +999,7 @@ namespace loc{
                 std::cout << "Orientation is updated. Reset succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
                 StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, pose, orientationMeasured)));
-                status->states(states, Status::RESET);
+                setParticles(states, Status::RESET);
                 callback(status.get());
                 return true;
             }else{
@@ -1014,7 +1018,7 @@ namespace loc{
                 std::cout << "Orientation is updated. Reset succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
                 StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured)));
-                status->states(states, Status::RESET);
+                setParticles(states, Status::RESET);
                 callback(status.get());
                 return true;
             }else{
@@ -1043,7 +1047,7 @@ namespace loc{
                     }
                 }
                 StatesPtr states(new States(statesTmp));
-                status->states(states, Status::RESET);
+                setParticles(states, Status::RESET);
                 callback(status.get());
                 return true;
             }else{
@@ -1070,7 +1074,7 @@ namespace loc{
             }
             States statesTmp = sampleStatesByObservation(mNumStates, beaconsFiltered);
             StatesPtr statesNew(new States(statesTmp));
-            status->states(statesNew, Status::RESET);
+            setParticles(statesNew, Status::RESET);
             status->timestamp(beacons.timestamp());
             if(mMetro){
                 ss << "an ObservationDependentInitializer.";
@@ -1106,7 +1110,7 @@ namespace loc{
             ss << "Status was initialized by ";
             States statesTmp = sampleStatesByLocationAndObservation(mNumStates, location, beaconsFiltered);
             StatesPtr statesNew(new States(statesTmp));
-            status->states(statesNew, Status::RESET);
+            setParticles(statesNew, Status::RESET);
             status->timestamp(beacons.timestamp());
             if(mMetro){
                 ss << "an ObservationDependentInitializer.";
@@ -1145,7 +1149,7 @@ namespace loc{
                     doFiltering(beaconsFiltered);
                 }
             }
-            std::shared_ptr<States> statesTmp = status->states();
+            std::shared_ptr<const States> statesTmp = status->states();
             std::vector<Location> locations(statesTmp->begin(), statesTmp->end());
             StatesPtr statesNew(new States(mStatusInitializer->initializeStatesFromLocations(locations)));
             status->timestamp(beacons.timestamp());
@@ -1167,13 +1171,14 @@ namespace loc{
             }
         }
 
-        bool checkIfDoFiltering(const States& states) const{
+        bool checkIfDoFiltering(const StatesSoA& states) const{
             double variance2DLowerBound = std::pow(mLocStdevLB.x(), 2)*std::pow(mLocStdevLB.y(),2);
             double stdZLB = mLocStdevLB.z();
             double stdFloorLB = mLocStdevLB.floor();
             
-            double variance2D = Location::compute2DVariance(states);
-            Location stdevLoc = Location::standardDeviation(states);
+            Locations locations = states.toLocations();
+            double variance2D = Location::compute2DVariance(locations);
+            Location stdevLoc = Location::standardDeviation(locations);
             
             if(mOptVerbose){
                 std::cout<<"var2D="<<variance2D<<","<<"var2DLB="<<variance2DLowerBound
@@ -1236,6 +1241,7 @@ namespace loc{
 
         void observationModel(std::shared_ptr<ObservationModel<State, Beacons>> observationModel){
             mObservationModel = observationModel;
+            mObservationModelSoA = std::dynamic_pointer_cast<ObservationModelSoA<Beacons>>(observationModel);
         }
 
         void resampler(std::shared_ptr<Resampler<State>> resampler){
@@ -354,12 +354,12 @@ namespace loc{
                 nSmoothTmp = nSmooth;
             }
             
-            status_list[(smooth_count++)%std::min(N_SMOOTH_MAX,nSmoothTmp)] = *statusLatest->states();
+            status_list[(smooth_count++)%std::min(N_SMOOTH_MAX,nSmoothTmp)] = statusLatest->states();
             
             std::shared_ptr<States> states (new std::vector<loc::State>);
             double meanBias = 0;
             for(int i = 0; i < N_SMOOTH_MAX && i < smooth_count && i < nSmoothTmp; i++) {
-                for(auto& s: status_list[i]) {
+                for(auto& s: *status_list[i]) {
                     states->push_back(s);
                     meanBias += s.rssiBias();
                 }
@@ -408,7 +408,7 @@ namespace loc{
         //if (isTrackingLocalizer() && isStatesConverged && mLocationStatus!=Status::STABLE) {
         if (isTrackingLocalizer() && isStatesConverged) {
             Pose refPose = *mResult->meanPose();
-            std::vector<State> states = *mResult->states();
+            const std::vector<State>& states = *mResult->states();
             auto idx = Location::findClosestLocationIndex(refPose, states);
             Location locClosest = states.at(idx);
             refPose.copyLocation(locClosest);
@@ -652,7 +652,16 @@ namespace loc{
         
         // Building - change read order to reduce memory usage peak
         //ImageHolder::setMode(ImageHolderMode(heavy));
-        if(has(json, "layers")){
+        ImageHolder::setUsesDenseRaster(basicLocalizerOptions.usesDenseFloorMap);
+        FloorMap::setUsesFreeRunTable(basicLocalizerOptions.usesWallAngleTable);
+        FloorMap::setUsesTransitionAreaRaster(basicLocalizerOptions.usesTransitionAreaRaster);
+        if(has(json, "BinaryBuildingData")){
+            auto& flatBuildingPath = getString(json, "BinaryBuildingData");
+            size_t tileCacheBytes = static_cast<size_t>(basicLocalizerOptions.floorMapTileCacheSize*1024*1024);
+            dataStore->building(Building::loadFlat(workingDir+"/"+flatBuildingPath, basicLocalizerOptions.floorMapTileSize, tileCacheBytes));
+            msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
+            std::cerr << "map flat building: " << msec << "ms" << std::endl;
+        }else if(has(json, "layers")){
             BuildingBuilder buildingBuilder;
             
             auto& layers = getArray(json, "layers");
@@ -790,6 +799,8 @@ namespace loc{
         // Sampling data
         
         // Samples samples;
+        // samples are only used for training and unique locations, so they are aggregated on ingestion
+        dataStore->aggregatesSamples(true);
         try{
             auto& samples = getArray(json, "samples");
             for(int i = 0; i < samples.size(); i++) {
@@ -802,7 +813,7 @@ namespace loc{
                 dataStore->readSamples(is);
             }
             {
-                std::cerr << dataStore->getSamples().size() << " samples have been loaded" << std::endl;
+                std::cerr << dataStore->getSampleAggregator()->nSamples() << " samples have been loaded" << std::endl;
             }
         }catch(const char* ch){
             std::cerr << "samples have not been loaded." << std::endl;
@@ -811,8 +822,8 @@ namespace loc{
         std::cerr << "load sample data: " << msec << "ms" << std::endl;
         
         // set unique locations to data store 
-        if(dataStore->getSamples().size() != 0){
-            const auto& uniLocs = Sample::extractUniqueLocations(dataStore->getSamples());
+        if(dataStore->getSampleAggregator()->nSamples() != 0){
+            const auto& uniLocs = dataStore->getSampleAggregator()->extractUniqueLocations();
             dataStore->locations(uniLocs);
         }
         
@@ -865,6 +876,9 @@ namespace loc{
             auto obsModelTrainer = std::make_shared<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>();
             obsModelTrainer->setGPType(basicLocalizerOptions.gpType);
             obsModelTrainer->setMatType(basicLocalizerOptions.matType);
+            obsModelTrainer->setNumInducingPoints(basicLocalizerOptions.numInducingPoints);
+            obsModelTrainer->setInducingPointPlacement(basicLocalizerOptions.inducingPointPlacement);
+            obsModelTrainer->setTrainingMemoryLimit(basicLocalizerOptions.trainingMemoryLimit);
             obsModelTrainer->dataStore(dataStore);
             std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(obsModelTrainer->train());
             obsModel->serializeVersionCheck();
@@ -921,6 +935,11 @@ namespace loc{
                         auto bldg = dataStore->getBuilding();
                         oarchive(cereal::make_nvp("building", bldg));
                         json.erase("layers");
+                    }else if(bTarget=="flatBuilding"){
+                        std::string flatBuildingFile = binaryFile + ".building";
+                        dataStore->getBuilding().saveFlat(workingDir+"/"+flatBuildingFile);
+                        json["BinaryBuildingData"] = (picojson::value)flatBuildingFile;
+                        json.erase("layers");
                     }
                 }
                 
@@ -941,6 +960,14 @@ namespace loc{
         // update additional parameters in the observation model
         // after training and serialization
         deserializedModel->coeffDiffFloorStdev(coeffDiffFloorStdev);
+        threadPool = std::make_shared<ThreadPool>(nThreads);
+        deserializedModel->threadPool(threadPool);
+        if(0<basicLocalizerOptions.gpCutoffRadius){
+            deserializedModel->cutoffRadius(basicLocalizerOptions.gpCutoffRadius);
+        }
+        if(basicLocalizerOptions.usesRssiRaster){
+            deserializedModel->buildRssiRaster(basicLocalizerOptions.rssiRasterCellSize, basicLocalizerOptions.rssiRasterMargin);
+        }
         if(1<=tDelay){
             deserializedModel->tDelay(tDelay);
         }
@@ -1026,6 +1053,7 @@ namespace loc{
         poseRandomWalkerInBuilding->poseRandomWalker(poseRandomWalker);
         poseRandomWalkerInBuilding->building(buildingPtr);
         poseRandomWalkerInBuilding->poseRandomWalkerInBuildingProperty(prwBuildingProperty);
+        poseRandomWalkerInBuilding->threadPool(threadPool);
         
         RandomWalkerProperty::Ptr randomWalkerProperty(new RandomWalkerProperty);
         randomWalkerProperty->sigma = 0.25;
@@ -1049,6 +1077,7 @@ namespace loc{
             randomWalkerMotion->setProperty(randomWalkerMotionProperty);
             // Setup SystemModelInBuilding
             SystemModelInBuilding<State, SystemModelInput>::Ptr rwMotionBldg(new SystemModelInBuilding<State, SystemModelInput>(randomWalkerMotion, buildingPtr, prwBuildingProperty) );
+            rwMotionBldg->threadPool(threadPool);
             mLocalizer->systemModel(rwMotionBldg);
         }
         else if (localizeMode == RANDOM_WALK) {
@@ -1067,6 +1096,7 @@ namespace loc{
             wPRWproperty->randomWalkRate(randomWalkRate);
             wPRW->setWeakPoseRandomWalkerProperty(wPRWproperty);
             SystemModelInBuilding<State, SystemModelInput>::Ptr wPRWBldg(new SystemModelInBuilding<State, SystemModelInput>(wPRW, buildingPtr, prwBuildingProperty) );
+            wPRWBldg->threadPool(threadPool);
             mLocalizer->systemModel(wPRWBldg);
         }
         
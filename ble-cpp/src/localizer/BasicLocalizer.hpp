@@ -193,6 +193,7 @@ namespace loc {
         // for observation model
         double coeffDiffFloorStdev = 5.0;
         int tDelay = -1; // 
+        int nThreads = 1; // number of threads to evaluate likelihoods and to predict particles (<=0: hardware concurrency)
         
         OrientationMeterType orientationMeterType = RAW_AVERAGE;
 
@@ -283,6 +284,7 @@ namespace loc {
             
             OPTIONAL_NVP(ar,usesAltimeterForFloorTransCheck);
             OPTIONAL_NVP(ar,coeffDiffFloorStdev);
+            OPTIONAL_NVP(ar,nThreads);
             
             OPTIONAL_NVP(ar,orientationMeterType);
             
@@ -317,6 +319,26 @@ namespace loc {
     public:
         GPType gpType = GPNORMAL;
         MatType matType = DENSE;
+        // inducing points of GPFITC
+        int numInducingPoints = 400;
+        GaussianProcessFITC::InducingPointPlacement inducingPointPlacement = GaussianProcessFITC::KMEANS;
+        // memory in bytes held at once by local models of GPLIGHT in training (0: half of physical memory)
+        size_t trainingMemoryLimit = 0;
+        // GP prediction only with training samples within cutoff radius (<=0: all samples)
+        double gpCutoffRadius = 0.0; // [m]
+        // precomputed RSSI prediction on grids instead of the exact prediction
+        bool usesRssiRaster = false;
+        double rssiRasterCellSize = 1.0; // [m]
+        double rssiRasterMargin = 10.0; // [m]
+        // dense floor map images for constant-time map queries (uses more memory)
+        bool usesDenseFloorMap = false;
+        // precomputed free-run distances near walls to estimate wall angles by table lookup
+        bool usesWallAngleTable = false;
+        // precomputed closest transition areas (stairs, elevators, escalators) instead of index queries
+        bool usesTransitionAreaRaster = false;
+        // tiles of flat building data read on first access (<=0: whole floor maps are memory-mapped)
+        int floorMapTileSize = 0; // [pixel]
+        double floorMapTileCacheSize = 64; // [MB]
     };
     
     class BasicLocalizer: public StreamLocalizer, public BasicLocalizerParameters{
@@ -324,6 +346,8 @@ namespace loc {
     private:
         std::shared_ptr<StreamParticleFilter> mLocalizer;
         std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> deserializedModel;
+        // workers shared by prediction and likelihood evaluation in every filter step
+        ThreadPool::Ptr threadPool;
         UserData userData;
         double isReady = false;
         
@@ -339,7 +363,7 @@ namespace loc {
         //std::shared_ptr<loc::Status> mResult;
         std::shared_ptr<Status> mTrackedStatus;
         
-        std::vector<loc::State> status_list[N_SMOOTH_MAX];
+        std::shared_ptr<const std::vector<loc::State>> status_list[N_SMOOTH_MAX];
         std::vector<loc::Beacon> beacons_list[N_SMOOTH_MAX];
         
         int smooth_count = 0;
@@ -399,7 +423,7 @@ namespace loc {
         std::string finalizedFile = "";
         BasicLocalizerOptions basicLocalizerOptions;
         
-        std::set<std::string> binarizeTargets{"model"}; // "model", "building"
+        std::set<std::string> binarizeTargets{"model"}; // "model", "building", "flatBuilding"
         
         bool finalizeMapdata = false;
         
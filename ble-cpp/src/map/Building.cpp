@@ -23,6 +23,13 @@
 #include "Building.hpp"
 #include "LocException.hpp"
 #include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <boost/tuple/tuple_io.hpp>
 #include <boost/algorithm/minmax_element.hpp>
@@ -44,6 +51,21 @@ namespace loc{
         
         minFloor_ = *twin_data.first;
         maxFloor_ = *twin_data.second;
+        setUpFloorTable();
+    }
+    
+    void Building::setUpFloorTable(){
+        floorTable_.clear();
+        floorExists_.clear();
+        if(floors.size()==0){
+            return;
+        }
+        floorTable_.resize(maxFloor_ - minFloor_ + 1);
+        floorExists_.resize(maxFloor_ - minFloor_ + 1, false);
+        for(const auto& floor: floors){
+            floorTable_[floor.first - minFloor_] = floor.second;
+            floorExists_[floor.first - minFloor_] = true;
+        }
     }
     
     const FloorMap& Building::getFloorAt(int floor_num) const{
@@ -56,7 +78,10 @@ namespace loc{
         if( maxFloor() < floor_num){
             BOOST_THROW_EXCEPTION(LocException("maxFloor < floor_num"));
         }
-        return floors.at(floor_num);
+        if(!floorExists_[floor_num - minFloor_]){
+            BOOST_THROW_EXCEPTION(LocException("floor_num is not found"));
+        }
+        return floorTable_[floor_num - minFloor_];
     }
     
     const FloorMap& Building::getFloorAt(const Location& location) const{
@@ -70,10 +95,15 @@ namespace loc{
         const FloorMap& floorMap = getFloorAt(floor_int);
         return floorMap.isMovable(location);
     }
+    
+    void Building::isMovable(int floor_num, const double x[], const double y[], size_t n, std::vector<bool>& movable) const{
+        const FloorMap& floorMap = getFloorAt(floor_num);
+        floorMap.isMovable(x, y, n, movable);
+    }
 
     bool Building::isValid(const Location& location) const{
         int floor_int = static_cast<int>(location.floor());
-        if(floors.count(floor_int)==0){
+        if(floorExists_.empty() || floor_int < minFloor() || maxFloor() < floor_int || !floorExists_[floor_int - minFloor_]){
             return false;
         }
         const FloorMap& floorMap = getFloorAt(floor_int);
@@ -192,6 +222,197 @@ namespace loc{
      Implementation of building builder
      **/
      
+    /*
+     Flat building file
+     
+     header | floor entries | arrays of each floor (64-byte aligned)
+     Arrays of a floor: color codes (uint8, rows*cols), distance to walls (uint8, rows*cols),
+     closest transition area (int32, rows*cols, optional). Values are in the byte order of the writer.
+     */
+    namespace{
+        const char flatMagic[8] = {'B','L','D','G','F','L','A','T'};
+        const uint32_t flatVersion = 1;
+        const uint64_t flatAlignment = 64;
+        
+        struct FlatHeader{
+            char magic[8];
+            uint32_t version;
+            uint32_t nFloors;
+        };
+        
+        struct FlatFloor{
+            int32_t floor;
+            int32_t rows;
+            int32_t cols;
+            int32_t reserved;
+            double coordinateSystem[6]; // punit_x, punit_y, punit_z, x_origin, y_origin, z_origin
+            uint64_t codesOffset;
+            uint64_t wallDistanceOffset;
+            uint64_t closestTransitionAreaOffset; // 0: not stored
+        };
+        
+        uint64_t alignOffset(uint64_t offset){
+            return (offset + flatAlignment - 1)/flatAlignment*flatAlignment;
+        }
+        
+        bool isInFile(uint64_t offset, uint64_t length, uint64_t fileSize){
+            return offset!=0 && offset%flatAlignment==0 && offset <= fileSize && length <= fileSize - offset;
+        }
+    }
+    
+    void Building::saveFlat(const std::string& path) const{
+        std::vector<FlatFloor> entries;
+        uint64_t offset = alignOffset(sizeof(FlatHeader) + floors.size()*sizeof(FlatFloor));
+        for(const auto& f: floors){
+            const FloorMap& floorMap = f.second;
+            const CoordinateSystemParameters& params = floorMap.mCoordSys.parameters();
+            FlatFloor entry;
+            std::memset(&entry, 0, sizeof(entry));
+            entry.floor = f.first;
+            entry.rows = floorMap.mImage.rows();
+            entry.cols = floorMap.mImage.cols();
+            double coordinateSystem[6] = {params.punit_x, params.punit_y, params.punit_z, params.x_origin, params.y_origin, params.z_origin};
+            std::memcpy(entry.coordinateSystem, coordinateSystem, sizeof(coordinateSystem));
+            uint64_t n = static_cast<uint64_t>(entry.rows)*entry.cols;
+            entry.codesOffset = offset;
+            offset = alignOffset(offset + n);
+            entry.wallDistanceOffset = offset;
+            offset = alignOffset(offset + n);
+            entry.closestTransitionAreaOffset = offset;
+            offset = alignOffset(offset + n*sizeof(int32_t));
+            entries.push_back(entry);
+        }
+        
+        std::ofstream ofs(path, std::ios::binary);
+        if(!ofs){
+            BOOST_THROW_EXCEPTION(LocException("Failed to open " + path));
+        }
+        FlatHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, flatMagic, sizeof(flatMagic));
+        header.version = flatVersion;
+        header.nFloors = static_cast<uint32_t>(entries.size());
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if(!entries.empty()){
+            ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(FlatFloor));
+        }
+        uint64_t written = sizeof(FlatHeader) + entries.size()*sizeof(FlatFloor);
+        auto writeAt = [&](uint64_t at, const void* data, uint64_t length){
+            static const char padding[flatAlignment] = {0};
+            while(written < at){
+                uint64_t m = std::min(at - written, flatAlignment);
+                ofs.write(padding, m);
+                written += m;
+            }
+            ofs.write(reinterpret_cast<const char*>(data), length);
+            written += length;
+        };
+        size_t i = 0;
+        for(const auto& f: floors){
+            const FloorMap& floorMap = f.second;
+            const FlatFloor& entry = entries[i++];
+            uint64_t n = static_cast<uint64_t>(entry.rows)*entry.cols;
+            std::vector<uint8_t> codes = floorMap.mImage.codes();
+            writeAt(entry.codesOffset, codes.data(), n);
+            std::vector<uint8_t> wallDistance(n);
+            for(int y=0; y<entry.rows; y++){
+                for(int x=0; x<entry.cols; x++){
+                    wallDistance[static_cast<size_t>(y)*entry.cols + x] = floorMap.wallDistanceAt(y, x);
+                }
+            }
+            writeAt(entry.wallDistanceOffset, wallDistance.data(), n);
+            // always stored so that tiled floor maps do not need indices built from whole images
+            FloorMap floorMapWithRaster(floorMap);
+            if(!floorMap.hasClosestTransitionArea()){
+                floorMapWithRaster.setUpTransitionAreaRaster();
+            }
+            std::vector<int32_t> closestTransitionArea(n);
+            for(int y=0; y<entry.rows; y++){
+                for(int x=0; x<entry.cols; x++){
+                    closestTransitionArea[static_cast<size_t>(y)*entry.cols + x] = floorMapWithRaster.closestTransitionAreaAt(y, x);
+                }
+            }
+            writeAt(entry.closestTransitionAreaOffset, closestTransitionArea.data(), n*sizeof(int32_t));
+        }
+        if(!ofs){
+            BOOST_THROW_EXCEPTION(LocException("Failed to write " + path));
+        }
+    }
+    
+    Building Building::loadFlat(const std::string& path, int tileSize, size_t tileCacheBytes){
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            BOOST_THROW_EXCEPTION(LocException("Failed to open " + path));
+        }
+        struct stat st;
+        if(fstat(fd, &st)!=0 || st.st_size < static_cast<off_t>(sizeof(FlatHeader))){
+            close(fd);
+            BOOST_THROW_EXCEPTION(LocException("Invalid flat building file " + path));
+        }
+        uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+        void* addr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(addr==MAP_FAILED){
+            BOOST_THROW_EXCEPTION(LocException("Failed to map " + path));
+        }
+        // arrays of floor maps share the ownership of the mapping
+        std::shared_ptr<const uint8_t> mapping(static_cast<const uint8_t*>(addr), [fileSize](const uint8_t* p){
+            munmap(const_cast<uint8_t*>(p), fileSize);
+        });
+        
+        FlatHeader header;
+        std::memcpy(&header, mapping.get(), sizeof(header));
+        if(std::memcmp(header.magic, flatMagic, sizeof(flatMagic))!=0){
+            BOOST_THROW_EXCEPTION(LocException("Invalid flat building file " + path));
+        }
+        if(header.version!=flatVersion){
+            BOOST_THROW_EXCEPTION(LocException("Unsupported version or byte order of flat building file " + path));
+        }
+        if(fileSize < sizeof(FlatHeader) + static_cast<uint64_t>(header.nFloors)*sizeof(FlatFloor)){
+            BOOST_THROW_EXCEPTION(LocException("Truncated flat building file " + path));
+        }
+        
+        RasterTileCache::Ptr tiles;
+        if(0 < tileSize){
+            tiles = std::make_shared<RasterTileCache>(path, tileSize, tileCacheBytes);
+        }
+        
+        std::map<int, FloorMap> floorsMap;
+        for(uint32_t i=0; i<header.nFloors; i++){
+            FlatFloor entry;
+            std::memcpy(&entry, mapping.get() + sizeof(FlatHeader) + i*sizeof(FlatFloor), sizeof(entry));
+            if(entry.rows <= 0 || entry.cols <= 0){
+                BOOST_THROW_EXCEPTION(LocException("Invalid image size in flat building file " + path));
+            }
+            uint64_t n = static_cast<uint64_t>(entry.rows)*entry.cols;
+            if(!isInFile(entry.codesOffset, n, fileSize)
+               || !isInFile(entry.wallDistanceOffset, n, fileSize)
+               || (entry.closestTransitionAreaOffset!=0 && !isInFile(entry.closestTransitionAreaOffset, n*sizeof(int32_t), fileSize))){
+                BOOST_THROW_EXCEPTION(LocException("Out-of-range array in flat building file " + path));
+            }
+            const double* cs = entry.coordinateSystem;
+            CoordinateSystemParameters params(cs[0], cs[1], cs[2], cs[3], cs[4], cs[5]);
+            if(tiles){
+                std::vector<RasterTileCache::Layer> layers{{entry.codesOffset, sizeof(uint8_t)}, {entry.wallDistanceOffset, sizeof(uint8_t)}};
+                if(entry.closestTransitionAreaOffset!=0){
+                    layers.push_back({entry.closestTransitionAreaOffset, sizeof(int32_t)});
+                }
+                int raster = tiles->addRaster(entry.rows, entry.cols, layers);
+                floorsMap[entry.floor] = FloorMap(CoordinateSystem(params), tiles, raster, std::to_string(entry.floor));
+                continue;
+            }
+            std::shared_ptr<const uint8_t> codes(mapping, mapping.get() + entry.codesOffset);
+            std::shared_ptr<const uint8_t> wallDistance(mapping, mapping.get() + entry.wallDistanceOffset);
+            std::shared_ptr<const int32_t> closestTransitionArea;
+            if(entry.closestTransitionAreaOffset!=0){
+                closestTransitionArea = std::shared_ptr<const int32_t>(mapping, reinterpret_cast<const int32_t*>(mapping.get() + entry.closestTransitionAreaOffset));
+            }
+            ImageHolder image(codes, entry.rows, entry.cols, std::to_string(entry.floor));
+            floorsMap[entry.floor] = FloorMap(image, CoordinateSystem(params), wallDistance, closestTransitionArea);
+        }
+        return Building(floorsMap);
+    }
+    
     BuildingBuilder& BuildingBuilder::addFloorCoordinateSystemParametersAndImagePath(int floor_num, CoordinateSystemParameters coordinateSystemParameters, std::string imagePath){
         
         mFloorCoordinateSystemParametersMap[floor_num] = coordinateSystemParameters;
@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <map>
+#include <vector>
 #include "Location.hpp"
 #include "FloorMap.hpp"
 #ifdef ANDROID_STL_EXT
@@ -37,6 +38,10 @@ namespace loc {
         int minFloor_;
         int maxFloor_;
         std::map<int, FloorMap> floors;
+        // floors indexed by (floor_num - minFloor_) for lookups without map search
+        std::vector<FloorMap> floorTable_;
+        std::vector<bool> floorExists_;
+        void setUpFloorTable();
         
     public:
         using Ptr = std::shared_ptr<Building>;
@@ -50,6 +55,7 @@ namespace loc {
         size_t nFloors() const { return this->floors.size(); }
 
         bool isMovable(const Location& location) const;
+        void isMovable(int floor_num, const double x[], const double y[], size_t n, std::vector<bool>& movable) const;
         bool isValid(const Location& location) const;
         bool isFloor(const Location& location) const;
         bool isWall(const Location& location) const;
@@ -69,12 +75,20 @@ namespace loc {
         
         double estimateWallAngle(const Location& start, const Location &end) const;
         
+        // Flat binary format: floor images and precomputed rasters are stored as raw arrays
+        // so that a file can be memory-mapped and used without decoding.
+        void saveFlat(const std::string& path) const;
+        // tileSize > 0: floor images and rasters are read in tiles of tileSize x tileSize pixels
+        // on first access and at most tileCacheBytes of least recently used tiles are kept
+        static Building loadFlat(const std::string& path, int tileSize = 0, size_t tileCacheBytes = 0);
+        
         template<class Archive>
         void serialize(Archive & ar, std::uint32_t const version)
         {
             ar(CEREAL_NVP(minFloor_));
             ar(CEREAL_NVP(maxFloor_));
             ar(CEREAL_NVP(floors));
+            setUpFloorTable();
         }
         
     };
@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "CoordinateSystem.hpp"
+#include <Eigen/Core>
 
 namespace loc{
     CoordinateSystemParameters::CoordinateSystemParameters(double punit_x, double punit_y, double punit_z, double x_origin, double y_origin, double z_origin){
@@ -39,5 +40,14 @@ namespace loc{
         }
         
     }
+    
+    void CoordinateSystem::worldToPixels(const double x[], const double y[], size_t n, int px[], int py[]) const{
+        // vectorized by Eigen (SSE/AVX/NEON)
+        using ArrayConstMap = Eigen::Map<const Eigen::ArrayXd>;
+        using ArrayIntMap = Eigen::Map<Eigen::ArrayXi>;
+        Eigen::Index size = static_cast<Eigen::Index>(n);
+        ArrayIntMap(px, size) = (mPara.punit_x * ArrayConstMap(x, size) + mPara.x_origin).round().cast<int>();
+        ArrayIntMap(py, size) = (mPara.punit_y * ArrayConstMap(y, size) + mPara.y_origin).round().cast<int>();
+    }
 
 }
@@ -27,6 +27,7 @@
 #define COORDINATE_SYSTEM_2D
 
 #include <stdio.h>
+#include <cmath>
 #include "LocException.hpp"
 #include "SerializeUtils.hpp"
 
@@ -64,9 +65,31 @@ namespace loc{
         CoordinateSystem(CoordinateSystemParameters parameters){
             mPara = parameters;
         }
+        const CoordinateSystemParameters& parameters() const{
+            return mPara;
+        }
         template<class Tstate> Tstate worldToLocalState(const Tstate& state) const;
         template<class Tstate> Tstate localToWorldState(const Tstate& state) const;
         
+        // Point-only transforms of (x, y) without copying a state
+        void worldToLocal(double x, double y, double& xLocal, double& yLocal) const{
+            xLocal = mPara.punit_x * x + mPara.x_origin;
+            yLocal = mPara.punit_y * y + mPara.y_origin;
+        }
+        void localToWorld(double xLocal, double yLocal, double& x, double& y) const{
+            x = (xLocal - mPara.x_origin)/mPara.punit_x;
+            y = (yLocal - mPara.y_origin)/mPara.punit_y;
+        }
+        // Pixel (rounded local coordinates) of a world point
+        void worldToPixel(double x, double y, int& px, int& py) const{
+            double xLocal, yLocal;
+            worldToLocal(x, y, xLocal, yLocal);
+            px = static_cast<int>(std::round(xLocal));
+            py = static_cast<int>(std::round(yLocal));
+        }
+        // Pixels of n world points (e.g. coordinate arrays of particles)
+        void worldToPixels(const double x[], const double y[], size_t n, int px[], int py[]) const;
+        
         template<class Archive>
         void serialize(Archive & ar, std::uint32_t const version)
         {
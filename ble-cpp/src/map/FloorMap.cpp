@@ -22,6 +22,8 @@
 
 #include "FloorMap.hpp"
 #include <cmath>
+#include <limits>
+#include <algorithm>
 
 namespace loc{
 
@@ -38,6 +40,40 @@ namespace loc{
     using namespace color;
     
     const std::vector<Color> colorTransitionArea{colorStairs, colorElevator, colorEscalator};
+    
+    namespace{
+        // One-dimensional squared Euclidean distance transform of a sampled function f
+        // (Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions", 2012)
+        // argmin (optional) receives the index of the sample attaining d[q].
+        void distanceTransform1D(const double f[], int n, double d[], int v[], double z[], int argmin[] = nullptr){
+            const double inf = std::numeric_limits<double>::infinity();
+            int k = 0;
+            v[0] = 0;
+            z[0] = -inf;
+            z[1] = inf;
+            for(int q=1; q<n; q++){
+                double s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k]))/(2*q - 2*v[k]);
+                while(s <= z[k]){
+                    k--;
+                    s = ((f[q] + q*q) - (f[v[k]] + v[k]*v[k]))/(2*q - 2*v[k]);
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k+1] = inf;
+            }
+            k = 0;
+            for(int q=0; q<n; q++){
+                while(z[k+1] < q){
+                    k++;
+                }
+                d[q] = (q - v[k])*(q - v[k]) + f[v[k]];
+                if(argmin){
+                    argmin[q] = v[k];
+                }
+            }
+        }
+    }
         
     FloorMap::FloorMap(ImageHolder image, CoordinateSystem coordSys){
         mImage = image;
@@ -46,13 +82,228 @@ namespace loc{
         //for(const Color&c : colorTransitionArea){
         //    mImage.setUpIndexForColor(c);
         //}
+        setUpWallDistance();
+        if(usesFreeRunTable){
+            setUpFreeRunTable();
+        }
+        if(usesTransitionAreaRaster){
+            setUpTransitionAreaRaster();
+        }
+    }
+    
+    FloorMap::FloorMap(ImageHolder image, CoordinateSystem coordSys, std::shared_ptr<const uint8_t> wallDistance, std::shared_ptr<const int32_t> closestTransitionArea){
+        mImage = image;
+        mCoordSys = coordSys;
+        mWallDistance = wallDistance;
+        mClosestTransitionArea = closestTransitionArea;
+        if(!mWallDistance){
+            setUpWallDistance();
+        }
+        if(usesFreeRunTable){
+            setUpFreeRunTable();
+        }
+        if(usesTransitionAreaRaster && !mClosestTransitionArea){
+            setUpTransitionAreaRaster();
+        }
+    }
+    
+    FloorMap::FloorMap(CoordinateSystem coordSys, RasterTileCache::Ptr tiles, int raster, const std::string& name){
+        mImage = ImageHolder(tiles, raster, name);
+        mCoordSys = coordSys;
+        mTiles = tiles;
+        mTileRaster = raster;
+        // the free-run table is not used because it reads all tiles
+        if(!hasClosestTransitionArea()){
+            for(const Color& c: colorTransitionArea){
+                mImage.setUpIndexForColor(c);
+            }
+        }
+    }
+    
+    bool FloorMap::hasWallDistance() const{
+        return mWallDistance || mTiles;
+    }
+    
+    uint8_t FloorMap::wallDistanceAt(int y, int x) const{
+        if(mWallDistance){
+            return mWallDistance.get()[static_cast<size_t>(y)*mImage.cols() + x];
+        }
+        return mTiles->get<uint8_t>(mTileRaster, tileWallDistance, y, x);
+    }
+    
+    bool FloorMap::hasClosestTransitionArea() const{
+        return mClosestTransitionArea || (mTiles && tileClosestTransitionArea < mTiles->nLayers(mTileRaster));
+    }
+    
+    int32_t FloorMap::closestTransitionAreaAt(int y, int x) const{
+        if(mClosestTransitionArea){
+            return mClosestTransitionArea.get()[static_cast<size_t>(y)*mImage.cols() + x];
+        }
+        return mTiles->get<int32_t>(mTileRaster, tileClosestTransitionArea, y, x);
+    }
+    
+    const int FloorMap::FreeRunTable::nDirections;
+    constexpr double FloorMap::FreeRunTable::maxRun;
+    bool FloorMap::usesFreeRunTable = false;
+    bool FloorMap::usesTransitionAreaRaster = false;
+    
+    void FloorMap::setUsesTransitionAreaRaster(bool usesRaster){
+        usesTransitionAreaRaster = usesRaster;
+    }
+    
+    void FloorMap::setUpTransitionAreaRaster(){
+        int rows = mImage.rows();
+        int cols = mImage.cols();
+        if(rows<=0 || cols<=0){
+            return;
+        }
+        // Feature transform: distance transform passes keeping the position of the closest transition area pixel
+        const double far = 1.0e20;
+        std::vector<double> sqDist(static_cast<size_t>(rows)*cols, far);
+        for(const Color& c: colorTransitionArea){
+            for(const auto& p: mImage.getPoints(c)){
+                sqDist[static_cast<size_t>(p.y)*cols + p.x] = 0;
+            }
+        }
+        int n = std::max(rows, cols);
+        std::vector<double> f(n), d(n), z(n+1);
+        std::vector<int> v(n), argmin(n);
+        std::vector<int> closestRows(static_cast<size_t>(rows)*cols);
+        for(int x=0; x<cols; x++){
+            for(int y=0; y<rows; y++){
+                f[y] = sqDist[static_cast<size_t>(y)*cols + x];
+            }
+            distanceTransform1D(f.data(), rows, d.data(), v.data(), z.data(), argmin.data());
+            for(int y=0; y<rows; y++){
+                sqDist[static_cast<size_t>(y)*cols + x] = d[y];
+                closestRows[static_cast<size_t>(y)*cols + x] = argmin[y];
+            }
+        }
+        auto raster = std::make_shared<std::vector<int32_t>>(static_cast<size_t>(rows)*cols, -1);
+        for(int y=0; y<rows; y++){
+            size_t offset = static_cast<size_t>(y)*cols;
+            distanceTransform1D(&sqDist[offset], cols, d.data(), v.data(), z.data(), argmin.data());
+            for(int x=0; x<cols; x++){
+                if(d[x] < far){
+                    int xClosest = argmin[x];
+                    int yClosest = closestRows[offset + xClosest];
+                    (*raster)[offset + x] = yClosest*cols + xClosest;
+                }
+            }
+        }
+        mClosestTransitionArea = std::shared_ptr<const int32_t>(raster, raster->data());
+    }
+    
+    void FloorMap::setUsesFreeRunTable(bool usesTable){
+        usesFreeRunTable = usesTable;
+    }
+    
+    void FloorMap::setUpFreeRunTable(){
+        if(!mWallDistance){
+            return;
+        }
+        const int nDirections = FreeRunTable::nDirections;
+        const double maxRun = FreeRunTable::maxRun;
+        int rows = mImage.rows();
+        int cols = mImage.cols();
+        auto table = std::make_shared<FreeRunTable>();
+        for(int y=0; y<rows; y++){
+            for(int x=0; x<cols; x++){
+                // free pixels where estimateWallAngle starts (the last free sample before a wall)
+                uint8_t dist = wallDistanceAt(y, x);
+                if(dist==0 || 2<dist){
+                    continue;
+                }
+                Location start = mCoordSys.localToWorldState(Location(x, y, 0, 0));
+                Location end(start);
+                table->keys.push_back(y*cols + x);
+                for(int k=0; k<nDirections; k++){
+                    double angle = 2.0*M_PI*k/nDirections;
+                    end.x(start.x() + maxRun*std::cos(angle));
+                    end.y(start.y() + maxRun*std::sin(angle));
+                    double run = std::max(0.0, wallCrossingRatio(start, end));
+                    table->runs.push_back(static_cast<uint8_t>(std::floor(run*255)));
+                }
+            }
+        }
+        mFreeRuns = table;
+    }
+    
+    double FloorMap::estimateWallAngleFromTable(const Location& nearWall, double angle, double norm) const{
+        const int nDirections = FreeRunTable::nDirections;
+        if(!mFreeRuns || FreeRunTable::maxRun < norm || !isInsideFloor(nearWall)){
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        ImageHolder::Point p = getPoint(nearWall);
+        const auto& keys = mFreeRuns->keys;
+        auto iter = std::lower_bound(keys.begin(), keys.end(), p.y*mImage.cols() + p.x);
+        if(iter==keys.end() || *iter != p.y*mImage.cols() + p.x){
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        const uint8_t* runs = &mFreeRuns->runs[(iter - keys.begin())*nDirections];
+        
+        // directions within 90 degrees ordered as in the exact search (smaller deviation first, negative side first)
+        std::vector<std::pair<double, int>> candidates;
+        for(int k=0; k<nDirections; k++){
+            double diff = Pose::computeOrientationDifference(angle, 2.0*M_PI*k/nDirections);
+            if(0 < std::abs(diff) && std::abs(diff) <= M_PI/2 && norm <= runs[k]*FreeRunTable::maxRun/255){
+                candidates.push_back(std::make_pair(std::abs(diff) + (diff<0 ? 0 : 1.0e-9), k));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        Location nearWall2(nearWall);
+        // The table is computed at pixel centers, so the chosen direction is verified from the actual location.
+        for(const auto& candidate: candidates){
+            double newAngle = 2.0*M_PI*candidate.second/nDirections;
+            nearWall2.x(nearWall.x() + std::cos(newAngle) * norm);
+            nearWall2.y(nearWall.y() + std::sin(newAngle) * norm);
+            if(wallCrossingRatio(nearWall, nearWall2) >= 1.0){
+                return Pose::normalizeOrientaion(newAngle);
+            }
+        }
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    
+    void FloorMap::setUpWallDistance(){
+        int rows = mImage.rows();
+        int cols = mImage.cols();
+        if(rows<=0 || cols<=0){
+            return;
+        }
+        // Squared distance is computed by column and row passes. A large finite value is used for non-wall pixels.
+        const double far = 1.0e20;
+        std::vector<double> sqDist(static_cast<size_t>(rows)*cols, far);
+        for(const auto& p: mImage.getPoints(colorWall)){
+            sqDist[static_cast<size_t>(p.y)*cols + p.x] = 0;
+        }
+        int n = std::max(rows, cols);
+        std::vector<double> f(n), d(n), z(n+1);
+        std::vector<int> v(n);
+        for(int x=0; x<cols; x++){
+            for(int y=0; y<rows; y++){
+                f[y] = sqDist[static_cast<size_t>(y)*cols + x];
+            }
+            distanceTransform1D(f.data(), rows, d.data(), v.data(), z.data());
+            for(int y=0; y<rows; y++){
+                sqDist[static_cast<size_t>(y)*cols + x] = d[y];
+            }
+        }
+        auto wallDistance = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(rows)*cols);
+        for(int y=0; y<rows; y++){
+            double* row = &sqDist[static_cast<size_t>(y)*cols];
+            distanceTransform1D(row, cols, d.data(), v.data(), z.data());
+            for(int x=0; x<cols; x++){
+                double dist = std::floor(std::sqrt(d[x]));
+                (*wallDistance)[static_cast<size_t>(y)*cols + x] = static_cast<uint8_t>(std::min(dist, 255.0));
+            }
+        }
+        mWallDistance = std::shared_ptr<const uint8_t>(wallDistance, wallDistance->data());
     }
 
     Color FloorMap::getColor(const Location& location) const{
-        if(isInsideFloor(location)){
-            Location localCoord = mCoordSys.worldToLocalState(location);
-            int x = getX(localCoord);
-            int y = getY(localCoord);
+        int x, y;
+        mCoordSys.worldToPixel(location.x(), location.y(), x, y);
+        if(mImage.checkValid(y, x)){
             Color pixelColor = mImage.get(y, x);
             return pixelColor;
         }else{
@@ -71,9 +322,8 @@ namespace loc{
     }
     
     ImageHolder::Point FloorMap::getPoint(const loc::Location &location) const{
-        Location localCoord = mCoordSys.worldToLocalState(location);
-        int x = getX(localCoord);
-        int y = getY(localCoord);
+        int x, y;
+        mCoordSys.worldToPixel(location.x(), location.y(), x, y);
         ImageHolder::Point p(x,y);
         return p;
     }
@@ -89,6 +339,15 @@ namespace loc{
         }
         return true;
     }
+    
+    void FloorMap::isMovable(const double x[], const double y[], size_t n, std::vector<bool>& movable) const{
+        std::vector<int> px(n), py(n);
+        mCoordSys.worldToPixels(x, y, n, px.data(), py.data());
+        movable.resize(n);
+        for(size_t i=0; i<n; i++){
+            movable[i] = !(mImage.checkValid(py[i], px[i]) && mImage.get(py[i], px[i]).equals(color::colorWall));
+        }
+    }
 
     bool FloorMap::isFloor(const Location &location) const{
         return checkColor(location, color::colorFloor);
@@ -99,18 +358,9 @@ namespace loc{
     }
     
     bool FloorMap::isInsideFloor(const Location& location) const{
-        Location localCoord = mCoordSys.worldToLocalState(location);
-        int x = getX(localCoord);
-        int y = getY(localCoord);
-        
-        int cols = mImage.cols();
-        int rows = mImage.rows();
-        
-        if ( 0<=x && x<cols && 0<=y && y<rows ){
-            return true;
-        }else{
-            return false;
-        }
+        int x, y;
+        mCoordSys.worldToPixel(location.x(), location.y(), x, y);
+        return mImage.checkValid(y, x);
     }
     
 
@@ -140,13 +390,11 @@ namespace loc{
     }
 
     double FloorMap::wallCrossingRatio(const Location& start, const Location& end) const{
-        Location startLocal = mCoordSys.worldToLocalState(start);
-        double x0 = (startLocal.x());
-        double y0 = (startLocal.y());
+        double x0, y0;
+        mCoordSys.worldToLocal(start.x(), start.y(), x0, y0);
 
-        Location endLocal = mCoordSys.worldToLocalState(end);
-        double x1 = (endLocal.x());
-        double y1 = (endLocal.y());
+        double x1, y1;
+        mCoordSys.worldToLocal(end.x(), end.y(), x1, y1);
 
         double norm = sqrt(pow(x1-x0,2)+pow(y1-y0,2));
 
@@ -154,14 +402,17 @@ namespace loc{
 
         double dx = (x1-x0)/norm_int;
         double dy = (y1-y0)/norm_int;
-
-        double x = x0;
-        double y = y0;
+        double step = norm/norm_int;
         
         bool startIsEscEnd = isEscalatorEnd(start);
+        // Samples closer to the current one than the nearest wall are skipped.
+        // Escalators also stop rays from escalator ends and are checked at every sample.
+        bool skipsFreeSpace = hasWallDistance() && !startIsEscEnd && 0<step;
 
         int count=0;
         while(count<=norm_int){
+            double x = x0 + dx*count;
+            double y = y0 + dy*count;
             int yInt = doubleToImageCoordinate(y);
             int xInt = doubleToImageCoordinate(x);
             Color c = color::colorFloor;
@@ -177,10 +428,17 @@ namespace loc{
             if(startIsEscEnd && c.equals(color::colorEscalator)){
                 return ((double)count-1)/norm_int;
             }
-            x+=dx;
-            y+=dy;
-            count++;
+            int nSteps = 1;
+            if(skipsFreeSpace && pixelIsValid){
+                // Rounding to pixels moves two samples apart by at most sqrt(2) pixels.
+                double freeDistance = wallDistanceAt(yInt, xInt) - M_SQRT2;
+                if(step < freeDistance){
+                    nSteps = static_cast<int>(std::ceil(freeDistance/step));
+                }
+            }
+            count += nSteps;
         }
+        count = std::min(count, norm_int+1);
         return ((double)count-1)/norm_int;
     }
 
@@ -204,6 +462,11 @@ namespace loc{
         nearWall.x(x);
         nearWall.y(y);
         
+        double angleFromTable = estimateWallAngleFromTable(nearWall, a, norm);
+        if(!std::isnan(angleFromTable)){
+            return angleFromTable;
+        }
+        
         int sign = 1;
         for(double angle = 1; angle<=90; angle++){
             for(int i=0; i<2; i++){
@@ -242,6 +505,19 @@ namespace loc{
         ImageHolder::Point pIm = getPoint(location);
         ImageHolder::Point pClosest;
         
+        if(hasClosestTransitionArea() && mImage.checkValid(pIm.y, pIm.x)){
+            std::vector<Location> locsRet;
+            int cols = mImage.cols();
+            int index = closestTransitionAreaAt(pIm.y, pIm.x);
+            if(index < 0){
+                return locsRet;
+            }
+            localCoord.x(index%cols);
+            localCoord.y(index/cols);
+            locsRet.push_back(mCoordSys.localToWorldState(localCoord));
+            return locsRet;
+        }
+        
         double dmin = std::numeric_limits<double>::max();
         for(auto& c: colorTransitionArea){
             auto psRet = mImage.findClosestPoints(c, pIm);
@@ -24,6 +24,8 @@
 #define FloorMap_hpp
 
 #include <stdio.h>
+#include <vector>
+#include <memory>
 
 #include "CoordinateSystem.hpp"
 #include "ImageHolder.hpp"
@@ -31,9 +33,38 @@
 
 namespace loc{
     class FloorMap{
+        friend class Building;
     protected:
         CoordinateSystem mCoordSys;
         ImageHolder mImage;
+        // distance [pixel] from each pixel to the nearest wall pixel (row-major, rounded down, saturated at 255)
+        std::shared_ptr<const uint8_t> mWallDistance;
+        void setUpWallDistance();
+        
+        // Free-run distances in fixed world directions from free pixels next to walls
+        struct FreeRunTable{
+            static const int nDirections = 64; // direction k has angle 2*pi*k/nDirections
+            static constexpr double maxRun = 5.0; // [m]
+            std::vector<int> keys; // y*cols + x (sorted)
+            std::vector<uint8_t> runs; // nDirections runs per key in units of maxRun/255
+        };
+        std::shared_ptr<const FreeRunTable> mFreeRuns;
+        static bool usesFreeRunTable;
+        void setUpFreeRunTable();
+        double estimateWallAngleFromTable(const Location& nearWall, double angle, double norm) const;
+        
+        // index (y*cols + x) of the closest stairs/elevator/escalator pixel for each pixel (-1: none)
+        std::shared_ptr<const int32_t> mClosestTransitionArea;
+        static bool usesTransitionAreaRaster;
+        void setUpTransitionAreaRaster();
+        
+        // rasters read from tiles on demand instead of the arrays above (see TileLayer)
+        RasterTileCache::Ptr mTiles;
+        int mTileRaster = -1;
+        bool hasWallDistance() const;
+        uint8_t wallDistanceAt(int y, int x) const;
+        bool hasClosestTransitionArea() const;
+        int32_t closestTransitionAreaAt(int y, int x) const;
 
         Color getColor(const Location& location) const;
         bool checkColor(const Location& location, const Color& color) const;
@@ -46,8 +77,17 @@ namespace loc{
         FloorMap() = default;
         ~FloorMap() = default;
         FloorMap(ImageHolder image, CoordinateSystem coordSys);
+        // Floor map with precomputed rasters (nullptr: computed here)
+        FloorMap(ImageHolder image, CoordinateSystem coordSys, std::shared_ptr<const uint8_t> wallDistance, std::shared_ptr<const int32_t> closestTransitionArea);
+        // Floor map reading its image and rasters from a tile cache
+        enum TileLayer{
+            tileColorCodes = 0, tileWallDistance = 1, tileClosestTransitionArea = 2 // optional
+        };
+        FloorMap(CoordinateSystem coordSys, RasterTileCache::Ptr tiles, int raster, const std::string& name);
 
         bool isMovable(const Location& location) const;
+        // isMovable for n points given by coordinate arrays
+        void isMovable(const double x[], const double y[], size_t n, std::vector<bool>& movable) const;
         bool isValid(const Location& location) const;
         bool isFloor(const Location& location) const;
         bool isWall(const Location& location) const;
@@ -62,6 +102,10 @@ namespace loc{
         bool checkCrossingWall(const Location& start, const Location& end) const;
 
         double estimateWallAngle(const Location&start, const Location& end) const;
+        // Precompute free-run distances near walls for estimateWallAngle when floor maps are created or loaded
+        static void setUsesFreeRunTable(bool usesTable);
+        // Precompute the closest transition area for each pixel so that findClosestTransitionAreaLocations does not query indices
+        static void setUsesTransitionAreaRaster(bool usesRaster);
         
         const CoordinateSystem& coordinateSystem() const;
         
@@ -73,6 +117,15 @@ namespace loc{
         {
             ar(CEREAL_NVP(mCoordSys));
             ar(CEREAL_NVP(mImage));
+            if(!mWallDistance){
+                setUpWallDistance();
+            }
+            if(usesFreeRunTable && !mFreeRuns){
+                setUpFreeRunTable();
+            }
+            if(usesTransitionAreaRaster && !mClosestTransitionArea){
+                setUpTransitionAreaRaster();
+            }
         }
         
     protected:
@@ -22,6 +22,10 @@
 
 #include <Eigen/SparseCore>
 #include <boost/bimap.hpp>
+#include <cstdint>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
 #include "ImageHolder.hpp"
 #include "LocException.hpp"
 #include <opencv2/flann/flann.hpp>
@@ -41,6 +45,7 @@ namespace loc{
     
     ImageHolderMode ImageHolder::mode_ = light;
     bool ImageHolder::precomputesIndex = false;
+    bool ImageHolder::usesDenseRaster = false;
     
     Color::Color(uint8_t r, uint8_t g, uint8_t b){
         r_ = r;
@@ -69,6 +74,19 @@ namespace loc{
         */
     };
     
+    static uint8_t colorToCode(const Color& color){
+        for(int i=0; i<colorList.size(); i++){
+            if(color.equals(colorList.at(i))){
+                return i;
+            }
+        }
+        return 0;
+    }
+    
+    static const Color& codeToColor(uint8_t code){
+        return code < colorList.size() ? colorList[code] : colorList[0];
+    }
+    
     static const std::vector<Color> colorsToIndices{
         color::red,
         color::lime,
@@ -264,6 +282,28 @@ namespace loc{
         // not to be serialized (created)
         boost::bimap<Color, uint8_t> colorIntBM;
         
+        // dense row-major copy of mat_ (optional)
+        static const int denseAlignment = 64;
+        std::vector<uint8_t> denseBuffer_;
+        const uint8_t* dense_ = nullptr;
+        int denseStride_ = 0;
+        
+        void setUpDenseRaster(){
+            int rows = static_cast<int>(mat_.rows());
+            int cols = static_cast<int>(mat_.cols());
+            // pad rows to cache lines
+            denseStride_ = (cols + denseAlignment - 1)/denseAlignment*denseAlignment;
+            denseBuffer_.assign(static_cast<size_t>(rows)*denseStride_ + denseAlignment, 0);
+            uint8_t* data = denseBuffer_.data();
+            data += (denseAlignment - reinterpret_cast<std::uintptr_t>(data)%denseAlignment)%denseAlignment;
+            for(int k=0; k<mat_.outerSize(); k++){
+                for(Eigen::SparseMatrix<uint8_t>::InnerIterator it(mat_, k); it; ++it){
+                    data[static_cast<size_t>(it.row())*denseStride_ + it.col()] = it.value();
+                }
+            }
+            dense_ = data;
+        }
+        
     public:
         ImplLight(){
             using bm_type = boost::bimap<Color, uint8_t>;
@@ -303,6 +343,9 @@ namespace loc{
             
             mat_.setFromTriplets(tripletList.begin(), tripletList.end());
             mat_.makeCompressed();
+            if(ImageHolder::usesDenseRaster){
+                setUpDenseRaster();
+            }
             
             this->setUpIndices();
         }
@@ -353,7 +396,7 @@ namespace loc{
         }
         
         Color get(int y, int x) const{
-            uint8_t code = mat_.coeff(y,x);
+            uint8_t code = dense_ ? dense_[static_cast<size_t>(y)*denseStride_ + x] : mat_.coeff(y,x);
             Color color = uint8ToColor(code);
             return color;
         }
@@ -393,6 +436,9 @@ namespace loc{
             ar(cereal::make_nvp("name_", name_));
             ar(cereal::make_nvp("mat_", mat_));
             //loadColorMat(ar);
+            if(ImageHolder::usesDenseRaster){
+                setUpDenseRaster();
+            }
         }
         
         class BinarySparseMatrix{
@@ -539,6 +585,208 @@ namespace loc{
         }
     };
     
+    class ImageHolder::ImplMapped : public ImageHolder::Impl{
+        std::string name_;
+        std::shared_ptr<const uint8_t> codes_;
+        int rows_ = 0;
+        int cols_ = 0;
+        
+    public:
+        ImplMapped(std::shared_ptr<const uint8_t> codes, int rows, int cols, const std::string& name)
+        : name_(name), codes_(codes), rows_(rows), cols_(cols){
+            this->setUpIndices();
+        }
+        ~ImplMapped() = default;
+        
+        int rows() const{
+            return rows_;
+        }
+        int cols() const{
+            return cols_;
+        }
+        
+        Color get(int y, int x) const{
+            return codeToColor(codes_.get()[static_cast<size_t>(y)*cols_ + x]);
+        }
+        
+        std::vector<Point> getPoints(const Color& c) const{
+            Points points;
+            uint8_t code_q = colorToCode(c);
+            const uint8_t* codes = codes_.get();
+            for(int y=0; y<rows_; y++){
+                for(int x=0; x<cols_; x++){
+                    if(codes[static_cast<size_t>(y)*cols_ + x] == code_q){
+                        points.push_back(Point(x, y));
+                    }
+                }
+            }
+            return points;
+        }
+    };
+    
+    class ImageHolder::ImplTiled : public ImageHolder::Impl{
+        std::string name_;
+        RasterTileCache::Ptr tiles_;
+        int raster_;
+        
+    public:
+        ImplTiled(RasterTileCache::Ptr tiles, int raster, const std::string& name)
+        : name_(name), tiles_(tiles), raster_(raster){
+            // indices are not set up here not to read all tiles
+        }
+        ~ImplTiled() = default;
+        
+        int rows() const{
+            return tiles_->rows(raster_);
+        }
+        int cols() const{
+            return tiles_->cols(raster_);
+        }
+        
+        Color get(int y, int x) const{
+            return codeToColor(tiles_->get<uint8_t>(raster_, 0, y, x));
+        }
+        
+        // reads all tiles
+        std::vector<Point> getPoints(const Color& c) const{
+            Points points;
+            uint8_t code_q = colorToCode(c);
+            for(int y=0; y<rows(); y++){
+                for(int x=0; x<cols(); x++){
+                    if(tiles_->get<uint8_t>(raster_, 0, y, x) == code_q){
+                        points.push_back(Point(x, y));
+                    }
+                }
+            }
+            return points;
+        }
+    };
+    
+    namespace{
+        std::atomic<uint64_t> nRasterTileCaches(0);
+        // number of tiles each thread keeps handles to
+        const int N_TILE_HANDLES = 4;
+    }
+    
+    RasterTileCache::RasterTileCache(const std::string& path, int tileSize, size_t maxBytes)
+    : id_(++nRasterTileCaches), path_(path), tileSize_(tileSize), maxBytes_(maxBytes){
+        if(tileSize_ <= 0){
+            BOOST_THROW_EXCEPTION(LocException("tileSize <= 0"));
+        }
+        fd_ = open(path.c_str(), O_RDONLY);
+        if(fd_ < 0){
+            BOOST_THROW_EXCEPTION(LocException("Failed to open " + path));
+        }
+    }
+    
+    RasterTileCache::~RasterTileCache(){
+        if(0 <= fd_){
+            close(fd_);
+        }
+    }
+    
+    int RasterTileCache::addRaster(int rows, int cols, const std::vector<Layer>& layers){
+        std::lock_guard<std::mutex> lock(mtx_);
+        rasters_.push_back(Raster{rows, cols, layers});
+        return static_cast<int>(rasters_.size()) - 1;
+    }
+    
+    size_t RasterTileCache::nLayers(int raster) const{
+        return rasters_.at(raster).layers.size();
+    }
+    
+    int RasterTileCache::rows(int raster) const{
+        return rasters_.at(raster).rows;
+    }
+    
+    int RasterTileCache::cols(int raster) const{
+        return rasters_.at(raster).cols;
+    }
+    
+    size_t RasterTileCache::residentBytes() const{
+        std::lock_guard<std::mutex> lock(mtx_);
+        return residentBytes_;
+    }
+    
+    uint64_t RasterTileCache::tileKey(int raster, int ty, int tx){
+        return (static_cast<uint64_t>(raster) << 48) | (static_cast<uint64_t>(ty) << 24) | static_cast<uint64_t>(tx);
+    }
+    
+    const RasterTileCache::Tile& RasterTileCache::tileAt(int raster, int ty, int tx) const{
+        struct Handle{
+            uint64_t cache = 0;
+            uint64_t key = 0;
+            std::shared_ptr<const Tile> tile;
+        };
+        static thread_local Handle handles[N_TILE_HANDLES];
+        static thread_local int nextHandle = 0;
+        uint64_t key = tileKey(raster, ty, tx);
+        for(const Handle& handle: handles){
+            if(handle.cache == id_ && handle.key == key){
+                return *handle.tile;
+            }
+        }
+        Handle& handle = handles[nextHandle];
+        nextHandle = (nextHandle + 1) % N_TILE_HANDLES;
+        handle.tile = getTile(raster, ty, tx);
+        handle.cache = id_;
+        handle.key = key;
+        return *handle.tile;
+    }
+    
+    std::shared_ptr<const RasterTileCache::Tile> RasterTileCache::getTile(int raster, int ty, int tx) const{
+        uint64_t key = tileKey(raster, ty, tx);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto iter = entries_.find(key);
+            if(iter != entries_.end()){
+                lru_.splice(lru_.begin(), lru_, iter->second);
+                return iter->second->second;
+            }
+        }
+        // Read the tile without blocking other threads. If another thread inserted the same tile meanwhile, use that one.
+        auto tile = loadTile(raster, ty, tx);
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto iter = entries_.find(key);
+        if(iter != entries_.end()){
+            lru_.splice(lru_.begin(), lru_, iter->second);
+            return iter->second->second;
+        }
+        lru_.emplace_front(key, tile);
+        entries_[key] = lru_.begin();
+        residentBytes_ += tile->bytes;
+        // tiles still referenced by callers are released when they are done
+        while(maxBytes_ < residentBytes_ && 1 < lru_.size()){
+            residentBytes_ -= lru_.back().second->bytes;
+            entries_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+        return tile;
+    }
+    
+    std::shared_ptr<const RasterTileCache::Tile> RasterTileCache::loadTile(int raster, int ty, int tx) const{
+        const Raster& r = rasters_.at(raster);
+        auto tile = std::make_shared<Tile>();
+        int y0 = ty*tileSize_;
+        int x0 = tx*tileSize_;
+        int h = std::min(tileSize_, r.rows - y0);
+        int w = std::min(tileSize_, r.cols - x0);
+        for(const Layer& layer: r.layers){
+            std::vector<uint8_t> data(static_cast<size_t>(tileSize_)*tileSize_*layer.elementSize, 0);
+            size_t length = w*layer.elementSize;
+            for(int y=0; y<h; y++){
+                uint64_t offset = layer.offset + (static_cast<uint64_t>(y0 + y)*r.cols + x0)*layer.elementSize;
+                uint8_t* dst = &data[static_cast<size_t>(y)*tileSize_*layer.elementSize];
+                if(pread(fd_, dst, length, offset) != static_cast<ssize_t>(length)){
+                    BOOST_THROW_EXCEPTION(LocException("Failed to read a tile from " + path_));
+                }
+            }
+            tile->bytes += data.size();
+            tile->layers.push_back(std::move(data));
+        }
+        return tile;
+    }
+    
     ImageHolder::ImageHolder(){
         if(mode_ == light){
             impl.reset(new ImplLight());
@@ -561,6 +809,14 @@ namespace loc{
         }
     }
     
+    ImageHolder::ImageHolder(std::shared_ptr<const uint8_t> codes, int rows, int cols, const std::string& name){
+        impl.reset(new ImplMapped(codes, rows, cols, name));
+    }
+    
+    ImageHolder::ImageHolder(RasterTileCache::Ptr tiles, int raster, const std::string& name){
+        impl.reset(new ImplTiled(tiles, raster, name));
+    }
+    
     ImageHolder::~ImageHolder(){}
     
     void ImageHolder::setMode(ImageHolderMode mode){
@@ -579,6 +835,18 @@ namespace loc{
         return impl->get(y, x);
     }
     
+    std::vector<uint8_t> ImageHolder::codes() const{
+        int rows = impl->rows();
+        int cols = impl->cols();
+        std::vector<uint8_t> codes(static_cast<size_t>(rows)*cols);
+        for(int y=0; y<rows; y++){
+            for(int x=0; x<cols; x++){
+                codes[static_cast<size_t>(y)*cols + x] = colorToCode(impl->get(y, x));
+            }
+        }
+        return codes;
+    }
+    
     void ImageHolder::setUpIndexForColor(const loc::Color &c){
         impl->setUpIndexForColor(c);
     }
@@ -595,6 +863,10 @@ namespace loc{
         ImageHolder::precomputesIndex = precomputesIdx;
     }
     
+    void ImageHolder::setUsesDenseRaster(bool usesDense){
+        ImageHolder::usesDenseRaster = usesDense;
+    }
+    
     
     template<class Archive>
     void ImageHolder::serialize(Archive & ar, std::uint32_t const version)
@@ -604,6 +876,9 @@ namespace loc{
         
         if(mode_ == ImageHolderMode::light){
             auto implLight = std::dynamic_pointer_cast<ImplLight>(impl);
+            if(!implLight){
+                BOOST_THROW_EXCEPTION(LocException("Serialization of ImageHolder::ImplMapped and ImplTiled is currently unsupported."));
+            }
             ar(cereal::make_nvp("implLight", *implLight));
         }else if(mode_ == ImageHolderMode::heavy){
             LocException ex("Serialization of ImageHolder::ImplHeavy is currently unsupported.");
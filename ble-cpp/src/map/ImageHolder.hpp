@@ -26,6 +26,11 @@
 #include <stdio.h>
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <cstring>
+#include <unordered_map>
 
 #include "SerializeUtils.hpp"
 
@@ -66,15 +71,86 @@ namespace loc {
         const Color maroon(128,0,0);
     }
         
+    /**
+     Square tiles of row-major rasters stored in a file (e.g. a flat building file).
+     Tiles are read on first access and kept in a least-recently-used cache of
+     bounded size shared by all rasters added to the cache.
+     Each thread keeps handles to the tiles it used last, so that reads within
+     those tiles take no lock.
+     **/
+    class RasterTileCache{
+    public:
+        using Ptr = std::shared_ptr<RasterTileCache>;
+        
+        struct Layer{
+            uint64_t offset; // file offset of the row-major array
+            size_t elementSize;
+        };
+        
+        RasterTileCache(const std::string& path, int tileSize, size_t maxBytes);
+        ~RasterTileCache();
+        RasterTileCache(const RasterTileCache&) = delete;
+        RasterTileCache& operator=(const RasterTileCache&) = delete;
+        
+        // Register layers of rows x cols rasters and return the id of the raster
+        int addRaster(int rows, int cols, const std::vector<Layer>& layers);
+        size_t nLayers(int raster) const;
+        int rows(int raster) const;
+        int cols(int raster) const;
+        
+        template<class T> T get(int raster, size_t layer, int y, int x) const{
+            const Tile& tile = tileAt(raster, y/tileSize_, x/tileSize_);
+            size_t i = static_cast<size_t>(y%tileSize_)*tileSize_ + x%tileSize_;
+            T value;
+            std::memcpy(&value, &tile.layers[layer][i*sizeof(T)], sizeof(T));
+            return value;
+        }
+        
+        size_t residentBytes() const;
+        
+    private:
+        struct Tile{
+            std::vector<std::vector<uint8_t>> layers;
+            size_t bytes = 0;
+        };
+        struct Raster{
+            int rows;
+            int cols;
+            std::vector<Layer> layers;
+        };
+        using Entry = std::pair<uint64_t, std::shared_ptr<const Tile>>;
+        
+        uint64_t id_; // identifies this cache in per-thread tile handles
+        int fd_ = -1;
+        std::string path_;
+        int tileSize_;
+        size_t maxBytes_;
+        std::vector<Raster> rasters_;
+        
+        mutable std::mutex mtx_;
+        mutable std::list<Entry> lru_; // most recently used first
+        mutable std::unordered_map<uint64_t, std::list<Entry>::iterator> entries_;
+        mutable size_t residentBytes_ = 0;
+        
+        static uint64_t tileKey(int raster, int ty, int tx);
+        // Tile through the handles of the calling thread. The reference is valid until the next call on the thread.
+        const Tile& tileAt(int raster, int ty, int tx) const;
+        std::shared_ptr<const Tile> getTile(int raster, int ty, int tx) const;
+        std::shared_ptr<const Tile> loadTile(int raster, int ty, int tx) const;
+    };
+    
     class ImageHolder{
         
         class Impl;
         class ImplHeavy;
         class ImplLight;
+        class ImplMapped;
+        class ImplTiled;
         std::shared_ptr<Impl> impl;
         
         static ImageHolderMode mode_;
         static bool precomputesIndex;
+        static bool usesDenseRaster;
         
     public:
         class Point{
@@ -90,6 +166,10 @@ namespace loc {
         
         ImageHolder();
         ImageHolder(const std::string& filepath, const std::string& name);
+        // View of row-major color codes (see codes()) owned by another object, e.g. a memory-mapped file
+        ImageHolder(std::shared_ptr<const uint8_t> codes, int rows, int cols, const std::string& name);
+        // Color codes read from layer 0 of a raster in a tile cache
+        ImageHolder(RasterTileCache::Ptr tiles, int raster, const std::string& name);
         ~ImageHolder();
         
         static void setMode(ImageHolderMode mode);
@@ -99,12 +179,16 @@ namespace loc {
         
         bool checkValid(int y, int x) const;
         Color get(int y, int x) const;
+        // Row-major color codes of the image
+        std::vector<uint8_t> codes() const;
         
         void setUpIndexForColor(const Color& c);
         std::vector<Point> getPoints(const Color& c) const;
         Points findClosestPoints(const Color&c, const Point& p, int k=1) const;
         
         static void setPrecomputesIndex(bool precomputesIdx);
+        // Keep a dense copy of images loaded in light mode for constant-time get(y, x)
+        static void setUsesDenseRaster(bool usesDense);
         
         template<class Archive>
         void serialize(Archive & ar, std::uint32_t const version);
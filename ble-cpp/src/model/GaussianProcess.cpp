@@ -23,10 +23,16 @@
 #include "GaussianProcess.hpp"
 #include "ArrayUtils.hpp"
 #include "SerializeUtils.hpp"
+#include "LocException.hpp"
+
+#include <algorithm>
 
 namespace loc{
     
     bool GaussianProcess::allowsAutoVersionUp = false;
+    long GaussianProcess::batchBlockSize = 256;
+    int GaussianProcess::fitCVNumThreads = 0;
+    size_t GaussianProcess::fitCVMemoryLimit = 0;
 
     template<class Archive>
     void GaussianProcess::serialize(Archive& ar){
@@ -115,15 +121,84 @@ namespace loc{
         actives(Actives);
         X_ = X;
         Y_ = Y;
-        size_t ns = X.rows();
         
-        K_ = computeKernelMatrix(X);
-        Eigen::MatrixXd sigmaNmat = (sigmaN_*sigmaN_) * Eigen::MatrixXd::Identity(ns,ns);
+        factorizeKy();
+        updateWeights();
+        
+        return *this;
+    }
+    
+    /**
+     Append samples by extending L to [[L11, 0], [L21, L22]] where
+     L21 = K21 L11^-T and L22 L22^T = K22 + sigmaN^2 I - L21 L21^T.
+     This costs O(n^2 k) for k new samples instead of O((n+k)^3) of refitting.
+     **/
+    GaussianProcess& GaussianProcess::append(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives){
+        if(X_.rows()==0){
+            return fit(X, Y, Actives);
+        }
+        long n = X_.rows();
+        long k = X.rows();
+        long m = asSparse_? WeightsSparse_.cols() : Weights_.cols();
+        if(X.cols()!=X_.cols() || Y.cols()!=m || Y.rows()!=k || Actives.rows()!=k || Actives.cols()!=m){
+            BOOST_THROW_EXCEPTION(LocException("Dimensions of appended samples do not match the fitted model."));
+        }
+        
+        // Y_ and the factor are not serialized. They are recovered from Y = L L^T Weights once after loading.
+        if(LKy_.rows()!=n){
+            factorizeKy();
+            Eigen::MatrixXd W = asSparse_? Eigen::MatrixXd(WeightsSparse_) : Weights_;
+            W = LKy_.triangularView<Eigen::Lower>().transpose()*W;
+            Y_ = LKy_.triangularView<Eigen::Lower>()*W;
+        }
+        if(Actives_.rows()!=n){
+            // activeness of loaded samples is unknown
+            Actives_ = Eigen::MatrixXd::Ones(n, m);
+        }
+        
+        Eigen::MatrixXd L21T = mGaussianKernel.computeKernelMatrix(X_, X);
+        LKy_.triangularView<Eigen::Lower>().solveInPlace(L21T);
+        Eigen::MatrixXd L22 = mGaussianKernel.computeKernelMatrix(X, X);
+        L22.diagonal().array() += sigmaN_*sigmaN_;
+        L22.noalias() -= L21T.transpose()*L21T;
+        Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(L22);
+        if(llt.info() != Eigen::Success){
+            BOOST_THROW_EXCEPTION(LocException("Cholesky update of the kernel matrix failed."));
+        }
+        
+        Eigen::MatrixXd L = Eigen::MatrixXd::Zero(n+k, n+k);
+        L.topLeftCorner(n, n) = LKy_;
+        L.bottomLeftCorner(k, n) = L21T.transpose();
+        L.bottomRightCorner(k, k) = L22.triangularView<Eigen::Lower>();
+        LKy_.swap(L);
+        
+        auto appendRows = [](Eigen::MatrixXd& A, const Eigen::MatrixXd& B){
+            Eigen::MatrixXd C(A.rows()+B.rows(), B.cols());
+            C << A, B;
+            A.swap(C);
+        };
+        appendRows(X_, X);
+        appendRows(Y_, Y);
+        appendRows(Actives_, Actives);
         
-        Ky_ = K_ + sigmaNmat;
-        invKy_ = Ky_.inverse();
+        updateWeights();
         
-        Weights_ = invKy_*Y_;
+        return *this;
+    }
+    
+    void GaussianProcess::factorizeKy(){
+        // Ky = K + sigmaN^2 I is factorized in place without forming its inverse
+        LKy_ = computeKernelMatrix(X_);
+        LKy_.diagonal().array() += sigmaN_*sigmaN_;
+        Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(LKy_);
+        if(llt.info() != Eigen::Success){
+            BOOST_THROW_EXCEPTION(LocException("Cholesky decomposition of the kernel matrix failed."));
+        }
+        LKy_.triangularView<Eigen::StrictlyUpper>().setZero();
+    }
+    
+    void GaussianProcess::updateWeights(){
+        Weights_ = solveKy(Y_);
         
         if(asSparse_){
             // from dense to sparse
@@ -131,8 +206,7 @@ namespace loc{
             WeightsSparse_.makeCompressed();
             Weights_.resize(0,0);
         }
-        
-        return *this;
+        buildSpatialIndex();
     }
     
     GaussianProcess& GaussianProcess::actives(const Eigen::MatrixXd &Actives){
@@ -173,6 +247,18 @@ namespace loc{
         size_t n = X_.rows();
         size_t nx = X_.cols();
         
+        if(usesSpatialIndex()){
+            Eigen::VectorXd kstar = Eigen::VectorXd::Zero(n);
+            std::vector<double> x_i(nx);
+            for(int i: findNeighbors(x)){
+                for(int j=0; j<nx; j++){
+                    x_i[j]=X_(i,j);
+                }
+                kstar(i) = mGaussianKernel.computeKernel(x, x_i.data());
+            }
+            return kstar;
+        }
+        
         Eigen::VectorXd kstar = Eigen::VectorXd(n);
         
         double* x_i;
@@ -190,6 +276,10 @@ namespace loc{
         return kstar;
     }
     
+    Eigen::MatrixXd GaussianProcess::computeKstars(const Eigen::MatrixXd& Xstar) const{
+        return mGaussianKernel.computeKernelMatrix(Xstar, X_);
+    }
+    
     Eigen::VectorXd GaussianProcess::predict(double x[]) const{
         Eigen::VectorXd kstar = computeKstar(x);
         return predict(kstar);
@@ -212,6 +302,29 @@ namespace loc{
     }
     
     std::vector<double> GaussianProcess::predict(double x[], const std::vector<int>& indices) const{
+        if(usesSpatialIndex()){
+            // Gather rows of weights only for training inputs within cutoff radius
+            size_t nx = X_.cols();
+            size_t m = indices.size();
+            std::vector<double> ypreds(m, 0.0);
+            std::vector<double> x_i(nx);
+            for(int i: findNeighbors(x)){
+                for(int j=0; j<nx; j++){
+                    x_i[j]=X_(i,j);
+                }
+                double k = mGaussianKernel.computeKernel(x, x_i.data());
+                if(asSparse_){
+                    for(int j=0; j<m; j++){
+                        ypreds[j] += k * WeightsSparseRowMajor_.coeff(i, indices[j]);
+                    }
+                }else{
+                    for(int j=0; j<m; j++){
+                        ypreds[j] += k * Weights_(i, indices[j]);
+                    }
+                }
+            }
+            return ypreds;
+        }
         Eigen::VectorXd kstar = computeKstar(x);
         return predict(kstar, indices);
     }
@@ -232,17 +345,89 @@ namespace loc{
         return ypreds;
     }
     
+    Eigen::MatrixXd GaussianProcess::predict(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const{
+        long N = Xstar.rows();
+        long n = X_.rows();
+        long m = indices.size();
+        Eigen::MatrixXd Ypred(N, m);
+        if(N==0 || m==0){
+            return Ypred;
+        }
+        
+        if(usesSpatialIndex()){
+            std::vector<double> x(Xstar.cols());
+            for(long r=0; r<N; r++){
+                for(int j=0; j<x.size(); j++){
+                    x[j] = Xstar(r,j);
+                }
+                std::vector<double> ypreds = predict(x.data(), indices);
+                Ypred.row(r) = Eigen::Map<Eigen::RowVectorXd>(ypreds.data(), m);
+            }
+            return Ypred;
+        }
+        
+        // Gather columns of weights for indices
+        Eigen::MatrixXd W(n, m);
+        for(int j=0; j<m; j++){
+            int index = indices.at(j);
+            if(asSparse_){
+                W.col(j) = WeightsSparse_.col(index);
+            }else{
+                W.col(j) = Weights_.col(index);
+            }
+        }
+        
+        // Block-wise to limit the size of kstar matrix
+        for(long begin=0; begin<N; begin+=batchBlockSize){
+            long rows = std::min(batchBlockSize, N-begin);
+            Eigen::MatrixXd Kstars = computeKstars(Xstar.middleRows(begin, rows));
+            Ypred.middleRows(begin, rows).noalias() = Kstars * W;
+        }
+        return Ypred;
+    }
+    
     Eigen::VectorXd GaussianProcess::predictVarianceF(double x[]) const{
         Eigen::VectorXd kstar = computeKstar(x);
         return predictVarianceF(kstar);
     }
     
     Eigen::VectorXd GaussianProcess::predictVarianceF(const Eigen::VectorXd& kstar) const{
-        //Eigen::VectorXd varianceF = mKernel->variance() - ((kstar.transpose())*invKy_*(kstar)).array();
-        Eigen::VectorXd varianceF = mGaussianKernel.variance() - ((kstar.transpose())*invKy_*(kstar)).array();
+        // kstar^T Ky^-1 kstar = |L^-1 kstar|^2
+        Eigen::VectorXd v = LKy_.triangularView<Eigen::Lower>().solve(kstar);
+        Eigen::VectorXd varianceF = Eigen::VectorXd::Constant(1, mGaussianKernel.variance() - v.squaredNorm());
         return varianceF;
     }
     
+    Eigen::VectorXd GaussianProcess::predictVarianceFs(const Eigen::MatrixXd& Xstar) const{
+        long N = Xstar.rows();
+        Eigen::VectorXd varianceFs(N);
+        for(long begin=0; begin<N; begin+=batchBlockSize){
+            long rows = std::min(batchBlockSize, N-begin);
+            Eigen::MatrixXd V = computeKstars(Xstar.middleRows(begin, rows)).transpose();
+            LKy_.triangularView<Eigen::Lower>().solveInPlace(V);
+            varianceFs.segment(begin, rows) = (mGaussianKernel.variance() - V.colwise().squaredNorm().array()).matrix().transpose();
+        }
+        return varianceFs;
+    }
+    
+    const Eigen::MatrixXd& GaussianProcess::choleskyKy() const{
+        return LKy_;
+    }
+    
+    Eigen::MatrixXd GaussianProcess::solveKy(const Eigen::MatrixXd& B) const{
+        Eigen::MatrixXd V = LKy_.triangularView<Eigen::Lower>().solve(B);
+        LKy_.triangularView<Eigen::Lower>().transpose().solveInPlace(V);
+        return V;
+    }
+    
+    Eigen::VectorXd GaussianProcess::diagonalInverseKy() const{
+        // (Ky^-1)_ii = |L^-1 e_i|^2
+        long n = LKy_.rows();
+        Eigen::MatrixXd invL = Eigen::MatrixXd::Identity(n, n);
+        LKy_.triangularView<Eigen::Lower>().solveInPlace(invL);
+        return invL.colwise().squaredNorm().transpose();
+    }
+    
     double GaussianProcess::computeLogLikelihood(double x[], const Eigen::VectorXd& y) const{
         Eigen::VectorXd kstar = computeKstar(x);
         
@@ -267,18 +452,15 @@ namespace loc{
         size_t m = Y_.cols();
         double sumMarginalLogLL = 0;
         
-        double logdetKy = 0;
-        Eigen::VectorXcd eigs = Ky_.eigenvalues();
+        // log|Ky| = 2 sum log L_ii
+        double logdetKy = 2.0*LKy_.diagonal().array().log().sum();
         
-        for(int i=0; i<eigs.size(); i++){
-            std::complex<double> eig = eigs(i);
-            logdetKy += log(eig.real());
-        }
+        // y^T Ky^-1 y = |L^-1 y|^2
+        Eigen::MatrixXd V = LKy_.triangularView<Eigen::Lower>().solve(Y_);
         
         // compute marginal log-likelihood for each BLE beacon
         for(int i=0; i<m; i++){
-            Eigen::VectorXd y = Y_.col(i);
-            double marginalLogLL = - 0.5*y.transpose()*invKy_*y - 0.5*logdetKy - 0.5*n*log(2*M_PI);
+            double marginalLogLL = - 0.5*V.col(i).squaredNorm() - 0.5*logdetKy - 0.5*n*log(2*M_PI);
             sumMarginalLogLL += marginalLogLL;
         }
         return sumMarginalLogLL;
@@ -288,15 +470,17 @@ namespace loc{
         size_t n = Y_.rows();
         size_t m = Y_.cols();
         
+        Eigen::MatrixXd invKyY = solveKy(Y_);
+        Eigen::VectorXd invKyDiag = diagonalInverseKy();
+        
         double sumPredLogLL = 0;
         for(int j=0; j<m; j++){
             double predLogLL_j = 0;
-            Eigen::VectorXd invKy_y = invKy_*(Y_.col(j));
             for(int i=0; i<n; i++){
                 double y = Y_(i,j);
                 if(Actives_(i,j)==1){
-                    double mu = y - invKy_y(i)/invKy_(i,i);
-                    double sigma_p2 = 1.0/invKy_(i,i);
+                    double mu = y - invKyY(i,j)/invKyDiag(i);
+                    double sigma_p2 = 1.0/invKyDiag(i);
                     double sigma_p = sqrt(sigma_p2);
                     double predLogLL_j_i = MathUtils::logProbaNormal(y, mu, sigma_p);
                     predLogLL_j += predLogLL_j_i;
@@ -315,8 +499,10 @@ namespace loc{
         size_t n = Y_.rows();
         size_t m = Y_.cols();
         
-        Eigen::MatrixXd Hmat =K_*invKy_;
-        Eigen::MatrixXd Ypred = Hmat*Y_;
+        // H = K Ky^-1 = I - sigmaN^2 Ky^-1
+        double sigmaN2 = sigmaN_*sigmaN_;
+        Eigen::MatrixXd Ypred = Y_ - sigmaN2*solveKy(Y_);
+        Eigen::VectorXd Hdiag = 1.0 - sigmaN2*diagonalInverseKy().array();
         
         double sumSquareError = 0;
         int count = 0;
@@ -326,7 +512,7 @@ namespace loc{
                     double y = Y_(i,j);
                     double ypred = Ypred(i,j);
                     double ei = y - ypred;
-                    double diff = ei/(1.0-Hmat(i,i));
+                    double diff = ei/(1.0-Hdiag(i));
                     double errorcv = diff*diff;
                     sumSquareError += errorcv;
                     count++;
@@ -360,26 +546,120 @@ namespace loc{
         return paramsMat;
     }
     
+    /**
+     Select kernel parameters by leave-one-out MSE.
+     LOO-MSE depends on sigmaF and sigmaN only through lambda = sigmaN^2/sigmaF^2 because
+     H = K Ky^-1 = R (R + lambda I)^-1 = I - lambda (R + lambda I)^-1 where R is the kernel
+     matrix with sigmaF=1. R is computed once per length scale and only diag(H) is computed.
+     When a length scale has many lambdas, R = Q diag(e) Q^T is decomposed once and
+     H = Q diag(e/(e+lambda)) Q^T gives each lambda in O(n^2 m). Otherwise R + lambda I is
+     factorized for each lambda (an eigendecomposition costs about ten Cholesky factorizations).
+     Length scales are evaluated in parallel. Each worker holds about four n x n matrices
+     (R and the eigenvectors with their squares, or R, R + lambda I, its factor and L^-1),
+     so the number of workers is bounded by fitCVMemoryLimit.
+     **/
     void GaussianProcess::fitCV(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives){
         std::vector<GaussianProcessParameters> gkParamsMatrix
                 = createParameterMatrix(mParameterSet);
         size_t nEval = gkParamsMatrix.size();
-        double minValue = std::numeric_limits<double>::max();
-        std::vector<double> gkParamsRowMin(6);
+        long n = Y.rows();
+        long m = Y.cols();
+        const size_t minLambdasForEigen = 10;
         
-        int indexMinError = 0;
+        // group parameters by length scales
+        std::vector<std::vector<int>> groups;
         for(int i=0; i<nEval; i++){
-            GaussianKernel::Parameters gkParams = gkParamsMatrix.at(i).gaussianKernelParameters;
-            double sigma_n = gkParamsMatrix.at(i).sigmaN;
-            this->sigmaN(sigma_n);
-            GaussianKernel gKernel(gkParams);
-            this->gaussianKernel(gKernel);
-            // fit GP
-            this->fit(X,Y,Actives);
+            const auto& lengthes = gkParamsMatrix.at(i).gaussianKernelParameters.lengthes;
+            auto iter = std::find_if(groups.begin(), groups.end(), [&](const std::vector<int>& group){
+                const auto& lengthesGroup = gkParamsMatrix.at(group.front()).gaussianKernelParameters.lengthes;
+                return std::equal(lengthes, lengthes+4, lengthesGroup);
+            });
+            if(iter==groups.end()){
+                groups.push_back(std::vector<int>{i});
+            }else{
+                iter->push_back(i);
+            }
+        }
+        
+        auto computeLooMSE = [&](const Eigen::MatrixXd& Ypred, const Eigen::VectorXd& Hdiag){
+            double sumSquareError = 0;
+            int count = 0;
+            for(long j=0; j<m; j++){
+                for(long i=0; i<n; i++){
+                    if(Actives(i,j)==1){
+                        double diff = (Y(i,j) - Ypred(i,j))/(1.0 - Hdiag(i));
+                        sumSquareError += diff*diff;
+                        count++;
+                    }
+                }
+            }
+            return sumSquareError/count;
+        };
+        
+        size_t memoryPerWorker = 4*sizeof(double)*static_cast<size_t>(n)*static_cast<size_t>(n);
+        int nThreads = ArrayUtils::numThreadsForMemory(fitCVNumThreads, memoryPerWorker, fitCVMemoryLimit);
+        if(nThreads < std::min(ArrayUtils::numThreads(fitCVNumThreads), static_cast<int>(groups.size()))){
+            std::cout << "fitCV: the number of threads is limited to " << nThreads << " by memory (n=" << n << ")" << std::endl;
+        }
+        
+        std::vector<double> looMSEs(nEval);
+        ArrayUtils::parallelFor(static_cast<int>(groups.size()), nThreads, [&](int g){
+            const auto& group = groups[g];
+            std::map<double, double> lambdaLooMSEs;
+            for(int i: group){
+                double sigmaF = gkParamsMatrix.at(i).gaussianKernelParameters.sigma_f;
+                double sigmaN = gkParamsMatrix.at(i).sigmaN;
+                lambdaLooMSEs[(sigmaN*sigmaN)/(sigmaF*sigmaF)] = 0;
+            }
+            GaussianKernel::Parameters unitParams = gkParamsMatrix.at(group.front()).gaussianKernelParameters;
+            unitParams.sigma_f = 1.0;
+            Eigen::MatrixXd R = GaussianKernel(unitParams).computeKernelMatrix(X, X);
             
-            double looMSE = this->leaveOneOutMSE();
+            if(minLambdasForEigen <= lambdaLooMSEs.size()){
+                Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigenSolver(R);
+                R.resize(0, 0);
+                const Eigen::MatrixXd& Q = eigenSolver.eigenvectors();
+                Eigen::ArrayXd e = eigenSolver.eigenvalues().array().max(0.0);
+                Eigen::MatrixXd QtY = Q.transpose()*Y;
+                Eigen::MatrixXd Q2 = Q.cwiseAbs2();
+                for(auto& lambdaLooMSE: lambdaLooMSEs){
+                    Eigen::VectorXd d = (e/(e + lambdaLooMSE.first)).matrix();
+                    Eigen::MatrixXd Ypred = Q*(d.asDiagonal()*QtY);
+                    Eigen::VectorXd Hdiag = Q2*d;
+                    lambdaLooMSE.second = computeLooMSE(Ypred, Hdiag);
+                }
+            }else{
+                Eigen::MatrixXd Ry(n, n);
+                Eigen::MatrixXd invL(n, n);
+                Eigen::LLT<Eigen::MatrixXd> llt(n);
+                for(auto& lambdaLooMSE: lambdaLooMSEs){
+                    double lambda = lambdaLooMSE.first;
+                    Ry = R;
+                    Ry.diagonal().array() += lambda;
+                    llt.compute(Ry);
+                    if(llt.info() != Eigen::Success){
+                        BOOST_THROW_EXCEPTION(LocException("Cholesky decomposition in fitCV failed (lambda=" + std::to_string(lambda) + ")."));
+                    }
+                    Eigen::MatrixXd Ypred = Y - lambda*llt.solve(Y);
+                    invL.setIdentity();
+                    llt.matrixL().solveInPlace(invL);
+                    Eigen::VectorXd Hdiag = (1.0 - lambda*invL.colwise().squaredNorm().array()).matrix().transpose();
+                    lambdaLooMSE.second = computeLooMSE(Ypred, Hdiag);
+                }
+            }
+            for(int i: group){
+                double sigmaF = gkParamsMatrix.at(i).gaussianKernelParameters.sigma_f;
+                double sigmaN = gkParamsMatrix.at(i).sigmaN;
+                looMSEs[i] = lambdaLooMSEs.at((sigmaN*sigmaN)/(sigmaF*sigmaF));
+            }
+        });
+        
+        double minValue = std::numeric_limits<double>::max();
+        int indexMinError = 0;
+        for(int i=0; i<nEval; i++){
+            double looMSE = looMSEs[i];
             std::cout << "LOOMSE=" << looMSE;
-            std::cout << ", (kernel parameters=" << gkParams.toString() << "," << sigma_n << std::endl;
+            std::cout << ", (kernel parameters=" << gkParamsMatrix.at(i).gaussianKernelParameters.toString() << "," << gkParamsMatrix.at(i).sigmaN << std::endl;
             if(looMSE < minValue){
                 minValue = looMSE;
                 indexMinError = i;
@@ -399,6 +679,94 @@ namespace loc{
         this->fit(X,Y,Actives);
     }
     
+    GaussianProcess& GaussianProcess::cutoffRadius(double cutoffRadius){
+        cutoffRadius_ = cutoffRadius;
+        buildSpatialIndex();
+        return *this;
+    }
+    
+    double GaussianProcess::cutoffRadius() const{
+        return cutoffRadius_;
+    }
+    
+    bool GaussianProcess::usesSpatialIndex() const{
+        return 0<cutoffRadius_ && 0<spatialIndex_.size();
+    }
+    
+    void GaussianProcess::buildSpatialIndex(){
+        spatialIndex_.clear();
+        WeightsSparseRowMajor_.resize(0,0);
+        WeightsSparseRowMajor_.data().squeeze();
+        if(cutoffRadius_<=0 || X_.rows()==0){
+            return;
+        }
+        
+        // Training inputs are registered to grid cells (size = cutoffRadius) on each floor
+        std::map<int, std::vector<int>> floorIndices;
+        for(int i=0; i<X_.rows(); i++){
+            floorIndices[(int) std::round(X_(i,3))].push_back(i);
+        }
+        for(const auto& pair: floorIndices){
+            const auto& indices = pair.second;
+            double xmin = X_(indices[0],0), xmax = xmin;
+            double ymin = X_(indices[0],1), ymax = ymin;
+            for(int i: indices){
+                xmin = std::min(xmin, X_(i,0));
+                xmax = std::max(xmax, X_(i,0));
+                ymin = std::min(ymin, X_(i,1));
+                ymax = std::max(ymax, X_(i,1));
+            }
+            SpatialGrid grid;
+            grid.x0 = xmin;
+            grid.y0 = ymin;
+            grid.nx = (int) std::floor((xmax-xmin)/cutoffRadius_) + 1;
+            grid.ny = (int) std::floor((ymax-ymin)/cutoffRadius_) + 1;
+            grid.cells.resize(grid.nx*grid.ny);
+            for(int i: indices){
+                int ix = (int) std::floor((X_(i,0)-grid.x0)/cutoffRadius_);
+                int iy = (int) std::floor((X_(i,1)-grid.y0)/cutoffRadius_);
+                grid.cells[iy*grid.nx + ix].push_back(i);
+            }
+            spatialIndex_[pair.first] = grid;
+        }
+        
+        // Row-wise sparse weights for gathering (dense weights are indexed directly)
+        if(asSparse_){
+            WeightsSparseRowMajor_ = WeightsSparse_;
+            WeightsSparseRowMajor_.makeCompressed();
+        }
+    }
+    
+    std::vector<int> GaussianProcess::findNeighbors(const double x[]) const{
+        std::vector<int> neighbors;
+        double r = cutoffRadius_;
+        double lengthFloor = mGaussianKernel.parameters().lengthes[3];
+        for(const auto& pair: spatialIndex_){
+            // skip floors on which kernel values are negligible
+            double dfloor = (pair.first - x[3])/lengthFloor;
+            if(36.0 < dfloor*dfloor){
+                continue;
+            }
+            const auto& grid = pair.second;
+            int ixmin = std::max(0, (int) std::floor((x[0]-r-grid.x0)/r));
+            int ixmax = std::min(grid.nx-1, (int) std::floor((x[0]+r-grid.x0)/r));
+            int iymin = std::max(0, (int) std::floor((x[1]-r-grid.y0)/r));
+            int iymax = std::min(grid.ny-1, (int) std::floor((x[1]+r-grid.y0)/r));
+            for(int iy=iymin; iy<=iymax; iy++){
+                for(int ix=ixmin; ix<=ixmax; ix++){
+                    for(int i: grid.cells[iy*grid.nx + ix]){
+                        double dx = X_(i,0) - x[0];
+                        double dy = X_(i,1) - x[1];
+                        if(dx*dx + dy*dy <= r*r){
+                            neighbors.push_back(i);
+                        }
+                    }
+                }
+            }
+        }
+        return neighbors;
+    }
+    
     void GaussianProcess::setAsSparse(bool asSparse){
         if(asSparse_ != asSparse){
             asSparse_ = asSparse;
@@ -413,6 +781,7 @@ namespace loc{
                 WeightsSparse_.resize(0,0);
                 WeightsSparse_.data().squeeze();
             }
+            buildSpatialIndex();
         }
     }
 }
@@ -29,9 +29,11 @@
 #include <memory>
 #include <complex>
 #include <cmath>
+#include <map>
 
 #include <Eigen/Core>
 #include <Eigen/LU>
+#include <Eigen/Cholesky>
 #include <Eigen/Eigenvalues>
 #include <Eigen/SparseCore>
 
@@ -74,12 +76,29 @@ namespace loc{
         
         // variables not to be serialized
         Eigen::MatrixXd Y_;
-        Eigen::MatrixXd K_;
-        Eigen::MatrixXd Ky_;
-        Eigen::MatrixXd invKy_;
+        Eigen::MatrixXd LKy_; // lower Cholesky factor of Ky = K + sigmaN^2 I = L L^T
         Eigen::MatrixXd Actives_;
         GaussianProcessParameterSet mParameterSet;
         
+        // spatial index of X_ for compact-support prediction
+        struct SpatialGrid{
+            double x0 = 0;
+            double y0 = 0;
+            int nx = 0;
+            int ny = 0;
+            std::vector<std::vector<int>> cells;
+        };
+        double cutoffRadius_ = 0.0;
+        std::map<int, SpatialGrid> spatialIndex_; // floor -> grid
+        Eigen::SparseMatrix<double, Eigen::RowMajor> WeightsSparseRowMajor_; // row access to sparse weights
+        
+        void buildSpatialIndex();
+        void factorizeKy();
+        void updateWeights();
+        Eigen::MatrixXd solveKy(const Eigen::MatrixXd& B) const;
+        bool usesSpatialIndex() const;
+        std::vector<int> findNeighbors(const double x[]) const;
+        
     protected:
         bool asSparse_ = false;
         
@@ -104,9 +123,12 @@ namespace loc{
         virtual GaussianProcess& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y);
         virtual GaussianProcess& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives);
         virtual GaussianProcess& actives(const Eigen::MatrixXd& Actives);
+        // Append samples to the fitted model with the kernel parameters fixed by extending the Cholesky factor of Ky.
+        virtual GaussianProcess& append(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives);
         
         virtual Eigen::MatrixXd computeKernelMatrix(const Eigen::MatrixXd& X);
         virtual Eigen::VectorXd computeKstar(double x[]) const;
+        virtual Eigen::MatrixXd computeKstars(const Eigen::MatrixXd& Xstar) const;
         
         virtual Eigen::VectorXd predict(double x[]) const;
         virtual Eigen::VectorXd predict(const Eigen::VectorXd& kstar) const;
@@ -114,8 +136,16 @@ namespace loc{
         virtual double predict(double x[], int index);
         virtual std::vector<double> predict(double x[], const std::vector<int>& indices) const;
         virtual std::vector<double> predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const;
+        // Batch prediction for the rows of Xstar (N x nx). Returns N x indices.size() matrix.
+        virtual Eigen::MatrixXd predict(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const;
         virtual Eigen::VectorXd predictVarianceF(double x[]) const;
         virtual Eigen::VectorXd predictVarianceF(const Eigen::VectorXd& kstar) const;
+        // Batch variance prediction for the rows of Xstar (N x nx). Returns N variances.
+        virtual Eigen::VectorXd predictVarianceFs(const Eigen::MatrixXd& Xstar) const;
+        // lower Cholesky factor of Ky available after fit
+        virtual const Eigen::MatrixXd& choleskyKy() const;
+        // diag(Ky^-1)
+        virtual Eigen::VectorXd diagonalInverseKy() const;
         
         virtual double computeLogLikelihood(double x[], const Eigen::VectorXd& y) const;
         virtual double marginalLogLikelihood();
@@ -126,7 +156,17 @@ namespace loc{
         virtual void fitCV(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives);
         
         virtual void setAsSparse(bool asSparse);
+        
+        // Kernel values are truncated to zero for training inputs farther than cutoffRadius in x-y plane (<=0: no truncation).
+        virtual GaussianProcess& cutoffRadius(double cutoffRadius);
+        virtual double cutoffRadius() const;
         static bool allowsAutoVersionUp;
+        // number of rows of Xstar processed at once in batch prediction
+        static long batchBlockSize;
+        // number of threads to evaluate length scales in fitCV (<=0: hardware concurrency)
+        static int fitCVNumThreads;
+        // memory in bytes that fitCV workers may hold in total (0: half of physical memory)
+        static size_t fitCVMemoryLimit;
     };
 }
 
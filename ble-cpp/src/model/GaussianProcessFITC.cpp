@@ -0,0 +1,527 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "GaussianProcessFITC.hpp"
+#include "ArrayUtils.hpp"
+#include "SerializeUtils.hpp"
+#include "LocException.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+
+namespace loc{
+    
+    // relative jitter added to the diagonal of Kuu for numerical stability
+    static const double JITTER = 1e-6;
+    
+    template<class Archive>
+    void GaussianProcessFITC::serialize(Archive& ar){
+        ar(CEREAL_NVP(sigmaN_));
+        ar(CEREAL_NVP(gaussianKernel_));
+        ar(CEREAL_NVP(numInducingPoints_));
+        ar(CEREAL_NVP(placement_));
+        ar(CEREAL_NVP(Z_));
+        ar(CEREAL_NVP(LKuu_));
+        ar(CEREAL_NVP(LA_));
+        ar(CEREAL_NVP(C_));
+        ar(CEREAL_NVP(Weights_));
+    }
+    
+    // Explicit instanciation
+    template void GaussianProcessFITC::serialize<cereal::JSONInputArchive> (cereal::JSONInputArchive& archive);
+    template void GaussianProcessFITC::serialize<cereal::JSONOutputArchive> (cereal::JSONOutputArchive& archive);
+    template void GaussianProcessFITC::serialize<cereal::PortableBinaryInputArchive> (cereal::PortableBinaryInputArchive& archive);
+    template void GaussianProcessFITC::serialize<cereal::PortableBinaryOutputArchive> (cereal::PortableBinaryOutputArchive& archive);
+    
+    GaussianProcessFITC& GaussianProcessFITC::sigmaN(double sigmaN){
+        sigmaN_ = sigmaN;
+        return *this;
+    }
+    
+    double GaussianProcessFITC::sigmaN() const{
+        return sigmaN_;
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::gaussianProcessParameterSet(const GaussianProcessParameterSet& gpParamsSet){
+        mParameterSet = gpParamsSet;
+        return *this;
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::gaussianKernel(GaussianKernel gaussianKernel){
+        gaussianKernel_ = gaussianKernel;
+        return *this;
+    }
+    
+    GaussianKernel GaussianProcessFITC::gaussianKernel() const{
+        return gaussianKernel_;
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::numInducingPoints(int numInducingPoints){
+        numInducingPoints_ = numInducingPoints;
+        return *this;
+    }
+    
+    int GaussianProcessFITC::numInducingPoints() const{
+        return numInducingPoints_;
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::inducingPointPlacement(InducingPointPlacement placement){
+        placement_ = placement;
+        return *this;
+    }
+    
+    GaussianProcessFITC::InducingPointPlacement GaussianProcessFITC::inducingPointPlacement() const{
+        return placement_;
+    }
+    
+    const Eigen::MatrixXd& GaussianProcessFITC::inducingPoints() const{
+        return Z_;
+    }
+    
+    void GaussianProcessFITC::selectInducingPoints(const Eigen::MatrixXd& X){
+        if(numInducingPoints_<=0){
+            BOOST_THROW_EXCEPTION(LocException("The number of inducing points must be positive."));
+        }
+        if(X.rows()<=numInducingPoints_){
+            Z_ = X;
+        }else if(placement_==KMEANS){
+            selectInducingPointsKMeans(X);
+        }else{
+            selectInducingPointsGrid(X);
+        }
+        std::cout << "#inducing points = " << Z_.rows() << std::endl;
+    }
+    
+    /**
+     k-means++ clustering of (x, y, z, floor). Floors are scaled so that no cluster spans floors.
+     **/
+    void GaussianProcessFITC::selectInducingPointsKMeans(const Eigen::MatrixXd& X){
+        const double FLOOR_SCALE = 1000.0;
+        const int MAX_ITERATION = 16;
+        const long n = X.rows();
+        const long nx = X.cols();
+        const long m = numInducingPoints_;
+        
+        Eigen::MatrixXd Xs = X;
+        Xs.col(3) *= FLOOR_SCALE;
+        auto sqdist = [&](long i, const Eigen::MatrixXd& centers, long k){
+            return (Xs.row(i) - centers.row(k)).squaredNorm();
+        };
+        
+        // choose initial centers
+        // distances to the new center are updated in the same serial pass as the cumulative sums
+        // (a pass costs O(n), which is too small to run in parallel for every center)
+        Eigen::MatrixXd centers(m, nx);
+        std::vector<double> minDists(n, DBL_MAX);
+        std::vector<double> cumsum(n);
+        std::mt19937 mt;
+        long chosen = std::uniform_int_distribution<long>(0, n-1)(mt);
+        for(long k=0; k<m; k++){
+            centers.row(k) = Xs.row(chosen);
+            if(k+1==m){
+                break;
+            }
+            double sum = 0.0;
+            for(long i=0; i<n; i++){
+                minDists[i] = std::min(minDists[i], sqdist(i, centers, k));
+                sum += minDists[i];
+                cumsum[i] = sum;
+            }
+            std::uniform_real_distribution<> rand(0.0, cumsum.back());
+            chosen = std::distance(cumsum.begin(), std::lower_bound(cumsum.begin(), cumsum.end(), rand(mt)));
+            chosen = std::min(chosen, n-1);
+        }
+        
+        // k-means
+        std::vector<long> labels(n);
+        for(int r=0; r<MAX_ITERATION; r++){
+            ArrayUtils::parallelFor(static_cast<int>(n), numThreads, [&](int i){
+                double min_d = DBL_MAX;
+                for(long k=0; k<m; k++){
+                    double d = sqdist(i, centers, k);
+                    if(d < min_d){
+                        min_d = d;
+                        labels[i] = k;
+                    }
+                }
+            });
+            Eigen::MatrixXd sums = Eigen::MatrixXd::Zero(m, nx);
+            Eigen::VectorXd counts = Eigen::VectorXd::Zero(m);
+            for(long i=0; i<n; i++){
+                sums.row(labels[i]) += Xs.row(i);
+                counts(labels[i]) += 1;
+            }
+            for(long k=0; k<m; k++){
+                // empty clusters keep their centers
+                if(0<counts(k)){
+                    centers.row(k) = sums.row(k)/counts(k);
+                }
+            }
+        }
+        centers.col(3) /= FLOOR_SCALE;
+        Z_ = centers;
+    }
+    
+    /**
+     Inducing points are placed at centers of square cells which contain training inputs on each floor.
+     The cell size is adjusted so that the number of cells is close to numInducingPoints_.
+     **/
+    void GaussianProcessFITC::selectInducingPointsGrid(const Eigen::MatrixXd& X){
+        const int MAX_ITERATION = 16;
+        const long n = X.rows();
+        const long m = numInducingPoints_;
+        
+        const double xmin = X.col(0).minCoeff();
+        const double ymin = X.col(1).minCoeff();
+        const double width = std::max(X.col(0).maxCoeff() - xmin, 1.0);
+        const double height = std::max(X.col(1).maxCoeff() - ymin, 1.0);
+        
+        // key: (floor, ix, iy), value: (sum of z, count)
+        typedef std::map<std::tuple<double, long, long>, std::pair<double, long>> Cells;
+        auto createCells = [&](double cellSize){
+            Cells cells;
+            for(long i=0; i<n; i++){
+                long ix = static_cast<long>(std::floor((X(i,0) - xmin)/cellSize));
+                long iy = static_cast<long>(std::floor((X(i,1) - ymin)/cellSize));
+                auto& cell = cells[std::make_tuple(X(i,3), ix, iy)];
+                cell.first += X(i,2);
+                cell.second++;
+            }
+            return cells;
+        };
+        
+        double cellSize = std::sqrt(width*height/m);
+        Cells cells = createCells(cellSize);
+        for(int r=0; r<MAX_ITERATION && m<(long)cells.size(); r++){
+            // occupied cells decrease roughly in proportion to the square of cell size
+            cellSize *= std::sqrt(1.05*cells.size()/m);
+            cells = createCells(cellSize);
+        }
+        
+        Z_.resize(cells.size(), X.cols());
+        long k = 0;
+        for(const auto& cell: cells){
+            double floor;
+            long ix, iy;
+            std::tie(floor, ix, iy) = cell.first;
+            Z_(k,0) = xmin + (ix + 0.5)*cellSize;
+            Z_(k,1) = ymin + (iy + 0.5)*cellSize;
+            Z_(k,2) = cell.second.first/cell.second.second;
+            Z_(k,3) = floor;
+            k++;
+        }
+    }
+    
+    void GaussianProcessFITC::factorizeKuu(){
+        LKuu_ = gaussianKernel_.computeKernelMatrix(Z_, Z_);
+        LKuu_.diagonal().array() += JITTER*gaussianKernel_.variance();
+        Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(LKuu_);
+        if(llt.info() != Eigen::Success){
+            BOOST_THROW_EXCEPTION(LocException("Cholesky decomposition of the kernel matrix of inducing points failed."));
+        }
+        LKuu_.triangularView<Eigen::StrictlyUpper>().setZero();
+    }
+    
+    void GaussianProcessFITC::accumulate(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, Eigen::MatrixXd& A, Eigen::MatrixXd& C) const{
+        const long n = X.rows();
+        const double variance = gaussianKernel_.variance();
+        const double sigmaN2 = sigmaN_*sigmaN_;
+        // Block-wise to limit the size of Kuf
+        for(long begin=0; begin<n; begin+=batchBlockSize){
+            long rows = std::min(batchBlockSize, n-begin);
+            Eigen::MatrixXd V = gaussianKernel_.computeKernelMatrix(Z_, X.middleRows(begin, rows));
+            LKuu_.triangularView<Eigen::Lower>().solveInPlace(V);
+            // Lambda = diag(K - Q) + sigmaN^2 I
+            Eigen::ArrayXd lambda = (variance - V.colwise().squaredNorm().array()).max(0.0) + sigmaN2;
+            Eigen::MatrixXd VinvLambda = V*lambda.inverse().matrix().asDiagonal();
+            A.noalias() += VinvLambda*V.transpose();
+            C.noalias() += VinvLambda*Y.middleRows(begin, rows);
+        }
+    }
+    
+    void GaussianProcessFITC::updateWeights(const Eigen::MatrixXd& A){
+        LA_ = A;
+        Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(LA_);
+        if(llt.info() != Eigen::Success){
+            BOOST_THROW_EXCEPTION(LocException("Cholesky decomposition in fitting FITC model failed."));
+        }
+        LA_.triangularView<Eigen::StrictlyUpper>().setZero();
+        
+        Weights_ = LA_.triangularView<Eigen::Lower>().solve(C_);
+        LA_.triangularView<Eigen::Lower>().transpose().solveInPlace(Weights_);
+        LKuu_.triangularView<Eigen::Lower>().transpose().solveInPlace(Weights_);
+    }
+    
+    void GaussianProcessFITC::fitWithInducingPoints(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y){
+        factorizeKuu();
+        long m = Z_.rows();
+        Eigen::MatrixXd A = Eigen::MatrixXd::Identity(m, m);
+        C_ = Eigen::MatrixXd::Zero(m, Y.cols());
+        accumulate(X, Y, A, C_);
+        updateWeights(A);
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y){
+        Eigen::MatrixXd Actives = Eigen::MatrixXd::Constant(Y.rows(), Y.cols(), 1.0);
+        return fit(X, Y, Actives);
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives){
+        selectInducingPoints(X);
+        fitWithInducingPoints(X, Y);
+        return *this;
+    }
+    
+    /**
+     The sufficient statistics A and C are sums over samples, so appended samples are added to them.
+     **/
+    GaussianProcessFITC& GaussianProcessFITC::append(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives){
+        if(Z_.rows()==0){
+            return fit(X, Y, Actives);
+        }
+        if(X.cols()!=Z_.cols() || Y.cols()!=C_.cols() || Y.rows()!=X.rows()){
+            BOOST_THROW_EXCEPTION(LocException("Dimensions of appended samples do not match the fitted model."));
+        }
+        Eigen::MatrixXd A = LA_*LA_.transpose();
+        accumulate(X, Y, A, C_);
+        updateWeights(A);
+        return *this;
+    }
+    
+    Eigen::VectorXd GaussianProcessFITC::computeKstar(double x[]) const{
+        long m = Z_.rows();
+        long nx = Z_.cols();
+        Eigen::VectorXd kstar(m);
+        std::vector<double> z(nx);
+        for(long k=0; k<m; k++){
+            for(long j=0; j<nx; j++){
+                z[j] = Z_(k,j);
+            }
+            kstar(k) = gaussianKernel_.computeKernel(x, z.data());
+        }
+        return kstar;
+    }
+    
+    Eigen::MatrixXd GaussianProcessFITC::computeKstars(const Eigen::MatrixXd& Xstar) const{
+        return gaussianKernel_.computeKernelMatrix(Xstar, Z_);
+    }
+    
+    Eigen::VectorXd GaussianProcessFITC::predict(double x[]) const{
+        return predict(computeKstar(x));
+    }
+    
+    Eigen::VectorXd GaussianProcessFITC::predict(const Eigen::VectorXd& kstar) const{
+        return Weights_.transpose()*kstar;
+    }
+    
+    double GaussianProcessFITC::predict(double x[], int index){
+        std::vector<int> indices(1, index);
+        return predict(x, indices)[0];
+    }
+    
+    std::vector<double> GaussianProcessFITC::predict(double x[], const std::vector<int>& indices) const{
+        return predict(computeKstar(x), indices);
+    }
+    
+    std::vector<double> GaussianProcessFITC::predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const{
+        size_t m = indices.size();
+        std::vector<double> ypreds(m);
+        for(int i=0; i<m; i++){
+            ypreds[i] = Weights_.col(indices.at(i)).dot(kstar);
+        }
+        return ypreds;
+    }
+    
+    Eigen::MatrixXd GaussianProcessFITC::predict(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const{
+        long N = Xstar.rows();
+        long m = indices.size();
+        Eigen::MatrixXd Ypred(N, m);
+        if(N==0 || m==0){
+            return Ypred;
+        }
+        
+        // Gather columns of weights for indices
+        Eigen::MatrixXd W(Weights_.rows(), m);
+        for(int j=0; j<m; j++){
+            W.col(j) = Weights_.col(indices.at(j));
+        }
+        
+        // Block-wise to limit the size of kstar matrix
+        for(long begin=0; begin<N; begin+=batchBlockSize){
+            long rows = std::min(batchBlockSize, N-begin);
+            Ypred.middleRows(begin, rows).noalias() = computeKstars(Xstar.middleRows(begin, rows))*W;
+        }
+        return Ypred;
+    }
+    
+    Eigen::VectorXd GaussianProcessFITC::predictVarianceF(double x[]) const{
+        return predictVarianceF(computeKstar(x));
+    }
+    
+    Eigen::VectorXd GaussianProcessFITC::predictVarianceF(const Eigen::VectorXd& kstar) const{
+        // k** - kstar^T (Kuu^-1 - Sigma) kstar where Sigma = Luu^-T A^-1 Luu^-1
+        Eigen::VectorXd v = LKuu_.triangularView<Eigen::Lower>().solve(kstar);
+        Eigen::VectorXd w = LA_.triangularView<Eigen::Lower>().solve(v);
+        Eigen::VectorXd varianceF = Eigen::VectorXd::Constant(1, gaussianKernel_.variance() - v.squaredNorm() + w.squaredNorm());
+        return varianceF;
+    }
+    
+    Eigen::VectorXd GaussianProcessFITC::predictVarianceFs(const Eigen::MatrixXd& Xstar) const{
+        long N = Xstar.rows();
+        Eigen::VectorXd varianceFs(N);
+        for(long begin=0; begin<N; begin+=batchBlockSize){
+            long rows = std::min(batchBlockSize, N-begin);
+            Eigen::MatrixXd V = computeKstars(Xstar.middleRows(begin, rows)).transpose();
+            LKuu_.triangularView<Eigen::Lower>().solveInPlace(V);
+            Eigen::MatrixXd W = LA_.triangularView<Eigen::Lower>().solve(V);
+            varianceFs.segment(begin, rows) = (gaussianKernel_.variance() - V.colwise().squaredNorm().array() + W.colwise().squaredNorm().array()).matrix().transpose();
+        }
+        return varianceFs;
+    }
+    
+    /**
+     Select kernel parameters by leave-one-out MSE of the FITC model whose prior covariance is C = Q + Lambda.
+     The LOO residual is (C^-1 y)_i/(C^-1)_ii, where C^-1 = Lambda^-1 - Lambda^-1 V^T A^-1 V Lambda^-1 by the
+     Woodbury identity, so each parameter costs O(n m^2) instead of O(n^3).
+     As in GaussianProcess::fitCV, LOO-MSE depends on sigmaF and sigmaN only through lambda = sigmaN^2/sigmaF^2,
+     so V is computed once per length scale with sigmaF=1. Length scales are evaluated in parallel; each worker holds
+     three m x n matrices (V, V Lambda^-1 and LA^-1 V) and the number of workers is bounded by fitCVMemoryLimit.
+     **/
+    void GaussianProcessFITC::fitCV(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives){
+        selectInducingPoints(X);
+        
+        std::vector<GaussianProcessParameters> gkParamsMatrix
+                = createParameterMatrix(mParameterSet);
+        size_t nEval = gkParamsMatrix.size();
+        long n = Y.rows();
+        long ny = Y.cols();
+        long m = Z_.rows();
+        
+        // group parameters by length scales
+        std::vector<std::vector<int>> groups;
+        for(int i=0; i<nEval; i++){
+            const auto& lengthes = gkParamsMatrix.at(i).gaussianKernelParameters.lengthes;
+            auto iter = std::find_if(groups.begin(), groups.end(), [&](const std::vector<int>& group){
+                const auto& lengthesGroup = gkParamsMatrix.at(group.front()).gaussianKernelParameters.lengthes;
+                return std::equal(lengthes, lengthes+4, lengthesGroup);
+            });
+            if(iter==groups.end()){
+                groups.push_back(std::vector<int>{i});
+            }else{
+                iter->push_back(i);
+            }
+        }
+        
+        size_t memoryPerWorker = 3*sizeof(double)*static_cast<size_t>(n)*static_cast<size_t>(m);
+        int nThreads = ArrayUtils::numThreadsForMemory(fitCVNumThreads, memoryPerWorker, fitCVMemoryLimit);
+        
+        std::vector<double> looMSEs(nEval);
+        ArrayUtils::parallelFor(static_cast<int>(groups.size()), nThreads, [&](int g){
+            const auto& group = groups[g];
+            std::map<double, double> lambdaLooMSEs;
+            for(int i: group){
+                double sigmaF = gkParamsMatrix.at(i).gaussianKernelParameters.sigma_f;
+                double sigmaN = gkParamsMatrix.at(i).sigmaN;
+                lambdaLooMSEs[(sigmaN*sigmaN)/(sigmaF*sigmaF)] = 0;
+            }
+            GaussianKernel::Parameters unitParams = gkParamsMatrix.at(group.front()).gaussianKernelParameters;
+            unitParams.sigma_f = 1.0;
+            GaussianKernel unitKernel(unitParams);
+            
+            Eigen::MatrixXd Ruu = unitKernel.computeKernelMatrix(Z_, Z_);
+            Ruu.diagonal().array() += JITTER;
+            Eigen::LLT<Eigen::MatrixXd> lltRuu(Ruu);
+            if(lltRuu.info() != Eigen::Success){
+                BOOST_THROW_EXCEPTION(LocException("Cholesky decomposition of the kernel matrix of inducing points failed."));
+            }
+            Eigen::MatrixXd V = unitKernel.computeKernelMatrix(Z_, X);
+            lltRuu.matrixL().solveInPlace(V);
+            Eigen::ArrayXd diagRminusQ = (1.0 - V.colwise().squaredNorm().array()).max(0.0);
+            
+            for(auto& lambdaLooMSE: lambdaLooMSEs){
+                Eigen::ArrayXd invLambda = (diagRminusQ + lambdaLooMSE.first).inverse();
+                Eigen::MatrixXd VinvLambda = V*invLambda.matrix().asDiagonal();
+                Eigen::MatrixXd A = Eigen::MatrixXd::Identity(m, m);
+                A.noalias() += VinvLambda*V.transpose();
+                Eigen::LLT<Eigen::MatrixXd> lltA(A);
+                if(lltA.info() != Eigen::Success){
+                    BOOST_THROW_EXCEPTION(LocException("Cholesky decomposition in fitting FITC model failed."));
+                }
+                // C^-1 Y = Lambda^-1 (Y - V^T A^-1 V Lambda^-1 Y)
+                Eigen::MatrixXd invCY = Y;
+                invCY.noalias() -= V.transpose()*lltA.solve(VinvLambda*Y);
+                invCY = invLambda.matrix().asDiagonal()*invCY;
+                // (C^-1)_ii = 1/Lambda_i - |LA^-1 V_i|^2/Lambda_i^2
+                Eigen::MatrixXd W = lltA.matrixL().solve(V);
+                Eigen::ArrayXd invCdiag = invLambda - W.colwise().squaredNorm().transpose().array()*invLambda.square();
+                
+                double sumSquareError = 0;
+                int count = 0;
+                for(long j=0; j<ny; j++){
+                    for(long i=0; i<n; i++){
+                        if(Actives(i,j)==1){
+                            double diff = invCY(i,j)/invCdiag(i);
+                            sumSquareError += diff*diff;
+                            count++;
+                        }
+                    }
+                }
+                lambdaLooMSE.second = sumSquareError/count;
+            }
+            for(int i: group){
+                double sigmaF = gkParamsMatrix.at(i).gaussianKernelParameters.sigma_f;
+                double sigmaN = gkParamsMatrix.at(i).sigmaN;
+                looMSEs[i] = lambdaLooMSEs.at((sigmaN*sigmaN)/(sigmaF*sigmaF));
+            }
+        });
+        
+        double minValue = std::numeric_limits<double>::max();
+        int indexMinError = 0;
+        for(int i=0; i<nEval; i++){
+            double looMSE = looMSEs[i];
+            std::cout << "LOOMSE=" << looMSE;
+            std::cout << ", (kernel parameters=" << gkParamsMatrix.at(i).gaussianKernelParameters.toString() << "," << gkParamsMatrix.at(i).sigmaN << std::endl;
+            if(looMSE < minValue){
+                minValue = looMSE;
+                indexMinError = i;
+                std::cout << "Min LOOMSE updated." << std::endl;
+            }
+        }
+        
+        // Fit this model with the selected parameters and the inducing points.
+        this->sigmaN(gkParamsMatrix.at(indexMinError).sigmaN);
+        this->gaussianKernel(GaussianKernel(gkParamsMatrix.at(indexMinError).gaussianKernelParameters));
+        fitWithInducingPoints(X, Y);
+    }
+    
+    GaussianProcessFITC& GaussianProcessFITC::cutoffRadius(double cutoffRadius){
+        return *this;
+    }
+    
+    double GaussianProcessFITC::cutoffRadius() const{
+        return 0.0;
+    }
+}
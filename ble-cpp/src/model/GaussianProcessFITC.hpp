@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef GaussianProcessFITC_hpp
+#define GaussianProcessFITC_hpp
+
+#include <iostream>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "KernelFunction.hpp"
+#include "GaussianProcess.hpp"
+
+namespace loc{
+    
+    /**
+     Sparse Gaussian process with inducing points (FITC approximation).
+     The prior covariance K is approximated by Q + diag(K - Q) where Q = Kfu Kuu^-1 Kuf.
+     With m inducing points, training costs O(n m^2) and prediction costs O(m) per input.
+     **/
+    class GaussianProcessFITC : public GaussianProcess{
+    
+    public:
+        enum InducingPointPlacement{
+            KMEANS, // k-means centers of training inputs
+            GRID    // centers of grid cells containing training inputs (= walkable area)
+        };
+    
+    private:
+        // variables to be serialized
+        double sigmaN_ = 1.0;
+        GaussianKernel gaussianKernel_;
+        int numInducingPoints_ = 400;
+        InducingPointPlacement placement_ = KMEANS;
+        Eigen::MatrixXd Z_;       // inducing points (m x nx)
+        Eigen::MatrixXd LKuu_;    // lower Cholesky factor of Kuu (+ jitter)
+        Eigen::MatrixXd LA_;      // lower Cholesky factor of A = I + V Lambda^-1 V^T (V = Luu^-1 Kuf)
+        Eigen::MatrixXd C_;       // V Lambda^-1 Y
+        Eigen::MatrixXd Weights_; // Luu^-T A^-1 C
+        
+        // variables not to be serialized
+        GaussianProcessParameterSet mParameterSet;
+        
+        void selectInducingPoints(const Eigen::MatrixXd& X);
+        void selectInducingPointsKMeans(const Eigen::MatrixXd& X);
+        void selectInducingPointsGrid(const Eigen::MatrixXd& X);
+        void factorizeKuu();
+        void fitWithInducingPoints(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y);
+        // A += V Lambda^-1 V^T and C += V Lambda^-1 Y for the rows of X
+        void accumulate(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, Eigen::MatrixXd& A, Eigen::MatrixXd& C) const;
+        void updateWeights(const Eigen::MatrixXd& A);
+    
+    public:
+        // number of threads to place inducing points (<=0: hardware concurrency)
+        int numThreads = 0;
+        
+        GaussianProcessFITC() = default;
+        
+        // A function for serealization
+        template<class Archive> void serialize(Archive& ar);
+        
+        GaussianProcessFITC& sigmaN(double sigmaN) override;
+        double sigmaN() const override;
+        GaussianProcessFITC& gaussianProcessParameterSet(const GaussianProcessParameterSet&) override;
+        GaussianProcessFITC& gaussianKernel(GaussianKernel gaussianKernel) override;
+        GaussianKernel gaussianKernel() const override;
+        
+        GaussianProcessFITC& numInducingPoints(int numInducingPoints);
+        int numInducingPoints() const;
+        GaussianProcessFITC& inducingPointPlacement(InducingPointPlacement placement);
+        InducingPointPlacement inducingPointPlacement() const;
+        const Eigen::MatrixXd& inducingPoints() const;
+        
+        GaussianProcessFITC& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y) override;
+        GaussianProcessFITC& fit(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives) override;
+        // Append samples with the inducing points and kernel parameters fixed. This costs O(k m^2 + m^3) for k new samples.
+        GaussianProcessFITC& append(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives) override;
+        
+        Eigen::VectorXd computeKstar(double x[]) const override;
+        Eigen::MatrixXd computeKstars(const Eigen::MatrixXd& Xstar) const override;
+        
+        Eigen::VectorXd predict(double x[]) const override;
+        Eigen::VectorXd predict(const Eigen::VectorXd& kstar) const override;
+        double predict(double x[], int index) override;
+        std::vector<double> predict(double x[], const std::vector<int>& indices) const override;
+        std::vector<double> predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const override;
+        Eigen::MatrixXd predict(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const override;
+        Eigen::VectorXd predictVarianceF(double x[]) const override;
+        Eigen::VectorXd predictVarianceF(const Eigen::VectorXd& kstar) const override;
+        Eigen::VectorXd predictVarianceFs(const Eigen::MatrixXd& Xstar) const override;
+        
+        // Kernel parameters are selected by leave-one-out MSE of the FITC model.
+        void fitCV(const Eigen::MatrixXd & X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives) override;
+        
+        // Prediction already costs O(m). Truncation by cutoff radius is not supported.
+        GaussianProcessFITC& cutoffRadius(double cutoffRadius) override;
+        double cutoffRadius() const override;
+    };
+}
+
+#endif /* GaussianProcessFITC_hpp */
@@ -20,6 +20,10 @@
  * THE SOFTWARE.
  *******************************************************************************/
 
+#include <algorithm>
+#include <numeric>
+#include <set>
+
 #include "GaussianProcessLDPLMultiModel.hpp"
 #include "ArrayUtils.hpp"
 #include "SerializeUtils.hpp"
@@ -38,7 +42,6 @@ namespace loc{
         return *this;
     }
     
-    /*
     void ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double feats[ndim_]) const{
         
         double distOffsetTmp = distanceOffset_;
@@ -56,23 +59,10 @@ namespace loc{
             feats[3] = -1.0;
         }
     }
-    */
     
     std::vector<double> ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter) const{
         std::vector<double> feats(ndim_);
-        double distOffsetTmp = distanceOffset_;
-        double dist = Location::distance(stateReceiver, stateTransmitter, distOffsetTmp);
-        double floorDiff = Location::floorDifference(stateReceiver, stateTransmitter);
-        
-        feats[0] = -10.0*log10(dist);
-        feats[1] = 1.0;
-        if(floorDiff<1){
-            feats[2] = 0.0;
-            feats[3] = 0.0;
-        }else{
-            feats[2] = -floorDiff;
-            feats[3] = -1.0;
-        }
+        transformFeature(stateReceiver, stateTransmitter, feats.data());
         return feats;
     }
     
@@ -101,6 +91,61 @@ namespace loc{
     template void ITUModelFunction::serialize<cereal::PortableBinaryOutputArchive> (cereal::PortableBinaryOutputArchive& archive);
     
     
+    /**
+     Implementation of RssiRaster
+     **/
+    RssiRaster::RssiRaster(double x0, double y0, double cellSize, int nx, int ny, int nBeacons)
+    : x0_(x0), y0_(y0), cellSize_(cellSize), nx_(nx), ny_(ny), nBeacons_(nBeacons){
+        if(nx_<2 || ny_<2){
+            BOOST_THROW_EXCEPTION(LocException("RssiRaster requires at least 2x2 grid points."));
+        }
+    }
+    
+    int RssiRaster::nx() const{
+        return nx_;
+    }
+    
+    int RssiRaster::ny() const{
+        return ny_;
+    }
+    
+    Location RssiRaster::location(int ix, int iy, int floor) const{
+        return Location(x0_ + ix*cellSize_, y0_ + iy*cellSize_, 0, floor);
+    }
+    
+    void RssiRaster::allocate(int floor){
+        values_[floor].resize((size_t)nx_*ny_*nBeacons_);
+    }
+    
+    float* RssiRaster::values(int ix, int iy, int floor){
+        auto& values = values_.at(floor);
+        return &values[((size_t)iy*nx_ + ix)*nBeacons_];
+    }
+    
+    bool RssiRaster::contains(const Location& location) const{
+        double floor = location.floor();
+        if(floor!=std::round(floor) || values_.count((int)floor)==0){
+            return false;
+        }
+        double fx = (location.x()-x0_)/cellSize_;
+        double fy = (location.y()-y0_)/cellSize_;
+        return 0<=fx && fx<=nx_-1 && 0<=fy && fy<=ny_-1;
+    }
+    
+    double RssiRaster::interpolate(const Location& location, int beaconIndex) const{
+        const auto& values = values_.at((int)location.floor());
+        double fx = (location.x()-x0_)/cellSize_;
+        double fy = (location.y()-y0_)/cellSize_;
+        int ix = std::min((int)fx, nx_-2);
+        int iy = std::min((int)fy, ny_-2);
+        double tx = fx - ix;
+        double ty = fy - iy;
+        auto value = [&](int jx, int jy){
+            return (double) values[((size_t)jy*nx_ + jx)*nBeacons_ + beaconIndex];
+        };
+        return (1-ty)*((1-tx)*value(ix,iy) + tx*value(ix+1,iy)) + ty*((1-tx)*value(ix,iy+1) + tx*value(ix+1,iy+1));
+    }
+    
     /**
      Implementation of GaussianProcessLDPLMultiModel
      **/
@@ -128,9 +173,7 @@ namespace loc{
     */
     
     template<class Tstate, class Tinput>
-    std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::fitITUModel(Samples samples){
-        std::vector<Sample> samplesAveraged = Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)); // averaging consecutive samples
-        std::cout << "#samplesAveraged = " << samplesAveraged.size() << std::endl;
+    std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::fitITUModel(const std::vector<Sample>& samplesAveraged){
         if(samplesAveraged.size()==0){
             throw std::runtime_error("No valid sample [samplesAveraged.size()==0]");
         }
@@ -237,15 +280,18 @@ namespace loc{
             Eigen::MatrixXd Lambdamat = lambdavec.asDiagonal();
             Eigen::MatrixXd Rhomat = rhovec.asDiagonal();
             
+            // workers are kept over the iterations
+            ThreadPool threadPool(std::min(ArrayUtils::numThreads(mNumTrainingThreads), std::max((int) m, 1)));
+            
             // convert to feature
-            for(int j=0; j<m; j++){
+            threadPool.parallelFor((int) m, [&](int j){
                 Eigen::MatrixXd Xmat(n, ndim);
                 Eigen::VectorXd Ymat(n);
-                BLEBeacon bleBeacon = mBLEBeacons.at(j);
+                const BLEBeacon& bleBeacon = mBLEBeacons.at(j);
+                const ITUModelFunction& ituModel = mITUModelMap.at(bleBeacon.id());
                 for(int i=0; i<n; i++){
-                    const auto& id = bleBeacon.id();
                     Location loc(X(i,0), X(i,1), X(i,2), X(i,3));
-                    auto features = mITUModelMap[id].transformFeature(loc, bleBeacon);
+                    auto features = ituModel.transformFeature(loc, bleBeacon);
                     for(int k = 0; k<ndim;k++){
                         Xmat(i, k) = features[k];
                     }
@@ -253,37 +299,35 @@ namespace loc{
                 }
                 Xmats[j] = Xmat;
                 Ymats[j] = Ymat;
-            }
+            });
             
             // iteration
             Eigen::MatrixXd paramsMatrix(m,ndim);
-            Eigen::VectorXd activevec(n);
             // initialize parameters
             for(int j=0; j<m; j++){
                 paramsMatrix.row(j) = params0;
             }
             bool wasConverged = false;
             for(int k=0; k<trainParams.maxIteration_; k++){
-                // Update parameters for each beacon
-                for(int j=0; j<m; j++){
+                // Update parameters for each beacon independently
+                threadPool.parallelFor((int) m, [&](int j){
+                    if(Xmats.at(j).rows()==0){
+                        return;
+                    }
                     Eigen::VectorXd paramsTmp = paramsMatrix.row(j);
-                    if(Xmats.at(j).rows()>0){
-                        for(int i=0; i<n; i++){
-                            double ypred = Xmats.at(j).row(i)*paramsTmp;
-                            if(BeaconConfig::minRssi()<ypred){
-                                activevec(i)=1.0;
-                            }else{
-                                activevec(i)=0.0;
-                            }
+                    // A = Xmat^T diag(active) Xmat + Lambda, b = Xmat^T diag(active) Ymat + Lambda params0
+                    Eigen::MatrixXd A = Lambdamat;
+                    Eigen::VectorXd b = Lambdamat*params0;
+                    for(int i=0; i<n; i++){
+                        auto xrow = Xmats.at(j).row(i);
+                        double ypred = xrow.dot(paramsTmp);
+                        if(BeaconConfig::minRssi()<ypred){
+                            A.noalias() += xrow.transpose()*xrow;
+                            b.noalias() += xrow.transpose()*Ymats.at(j)(i);
                         }
-                        Eigen::MatrixXd A = Xmats.at(j).transpose()*(activevec.asDiagonal())*Xmats.at(j) + Lambdamat;
-                        Eigen::VectorXd b = Xmats.at(j).transpose()*(activevec.asDiagonal())*Ymats.at(j) + Lambdamat*params0;
-                        paramsTmp = A.colPivHouseholderQr().solve(b);
-                    }else{
-                        paramsTmp = paramsMatrix.row(j);
                     }
-                    paramsMatrix.row(j) = paramsTmp;
-                }
+                    paramsMatrix.row(j) = A.colPivHouseholderQr().solve(b);
+                });
                 {
                     // Update mean ITU parameters;
                     Eigen::VectorXd paramsMean(ndim);
@@ -331,12 +375,24 @@ namespace loc{
     
     
     template<class Tstate, class Tinput>
-    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::train(Samples samples){
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::train(const SampleAggregator& aggregator){
         
         if(gpType==GPNORMAL){
             mGP = std::make_shared<GaussianProcess>();
+        }else if(gpType==GPFITC){
+            auto fgp = std::make_shared<GaussianProcessFITC>();
+            fgp->numInducingPoints(mNumInducingPoints);
+            fgp->inducingPointPlacement(mInducingPointPlacement);
+            fgp->numThreads = mNumTrainingThreads;
+            mGP = fgp;
+            if(version < FITC_SUPPORTED_MIN_VERSION){
+                version = FITC_SUPPORTED_MIN_VERSION;
+            }
         }else{
-            mGP = std::make_shared<GaussianProcessLight>();
+            auto lgp = std::make_shared<GaussianProcessLight>();
+            lgp->numThreads = mNumTrainingThreads;
+            lgp->fitMemoryLimit = mTrainingMemoryLimit;
+            mGP = lgp;
         }
         
         if(matType==DENSE){
@@ -345,7 +401,7 @@ namespace loc{
             mGP->setAsSparse(true);
         }
         
-        std::vector<Sample> samplesAveraged = Sample::mean(Sample::splitSamplesToConsecutiveSamples(samples)); // averaging consecutive samples
+        std::vector<Sample> samplesAveraged = aggregator.meanSamples(); // averaging consecutive samples
         std::cout << "#samplesAveraged = " << samplesAveraged.size() << std::endl;
         
         // construct beacon id to index map
@@ -353,6 +409,88 @@ namespace loc{
             BOOST_THROW_EXCEPTION(LocException("BLEBeacons have not been set to this instance."));
         }
         
+        // FIT ITU model parameters
+        mITUParameters = fitITUModel(samplesAveraged);
+        
+        // Compute dY = Y - m(X)
+        Eigen::MatrixXd X, dY, Actives;
+        std::tie(X, dY, Actives) = computeResidualMatrices(samplesAveraged);
+        
+        // Training with selection of kernel parameters
+        mGP->fitCV(X, dY, Actives);
+        
+        // Estimate variance parameter (sigma_n) by using raw (=not averaged) data
+        mRssiStandardDeviations.clear();
+        mRssiCounts.assign(mBLEBeacons.size(), 0);
+        mRssiSquareErrorSums.assign(mBLEBeacons.size(), 0.0);
+        accumulateRssiSquareErrors(aggregator.aggregatedSamples());
+        updateRssiStandardDeviations();
+        
+        if(mStdevRssiForUnknownBeacon==0){
+            mStdevRssiForUnknownBeacon = computeNormalStandardDeviation(mRssiStandardDeviations);
+        }
+        
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::appendSamples(const Samples& samples){
+        SampleAggregator aggregator;
+        aggregator.add(samples);
+        return appendSamples(aggregator);
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::appendSamples(const SampleAggregator& aggregator){
+        if(!mGP){
+            BOOST_THROW_EXCEPTION(LocException("GaussianProcessLDPLMultiModel has not been trained."));
+        }
+        SampleAggregator aggregatorFiltered = aggregator.filterUnregisteredBeacons(mBLEBeacons);
+        std::vector<Sample> samplesAveraged = aggregatorFiltered.meanSamples(); // averaging consecutive samples
+        std::cout << "#samplesAveraged (appended) = " << samplesAveraged.size() << std::endl;
+        
+        // ITU parameters and kernel parameters are kept fixed
+        Eigen::MatrixXd X, dY, Actives;
+        std::tie(X, dY, Actives) = computeResidualMatrices(samplesAveraged);
+        mGP->append(X, dY, Actives);
+        
+        // Square errors of the previous samples are not recomputed with the updated GP.
+        // After loading, the statistics are seeded from the current stdevs weighted by mRssiPriorCount.
+        if(mRssiCounts.size()!=mBLEBeacons.size()){
+            mRssiCounts.assign(mBLEBeacons.size(), 0);
+            mRssiSquareErrorSums.assign(mBLEBeacons.size(), 0.0);
+            if(mRssiStandardDeviations.size()==mBLEBeacons.size()){
+                for(size_t i=0; i<mBLEBeacons.size(); i++){
+                    double stdev = mRssiStandardDeviations.at(i);
+                    if(!std::isnan(stdev)){
+                        mRssiCounts[i] = mRssiPriorCount;
+                        mRssiSquareErrorSums[i] = mRssiPriorCount*stdev*stdev;
+                    }
+                }
+            }
+        }
+        accumulateRssiSquareErrors(aggregatorFiltered.aggregatedSamples());
+        updateRssiStandardDeviations();
+        
+        // predicted mean RSSI has been changed
+        clearRssiRaster();
+        
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::rssiPriorCount(int count){
+        mRssiPriorCount = count;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    int GaussianProcessLDPLMultiModel<Tstate, Tinput>::rssiPriorCount() const{
+        return mRssiPriorCount;
+    }
+    
+    template<class Tstate, class Tinput>
+    std::tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeResidualMatrices(const std::vector<Sample>& samplesAveraged) const{
         // convert samples to X, Y matrices
         size_t n = samplesAveraged.size();
         size_t m = mBeaconIdIndexMap.size();
@@ -363,11 +501,8 @@ namespace loc{
         
         bool usesMinRssiObs = true;
         
-        // FIT ITU model parameters
-        mITUParameters = fitITUModel(samples);
-        
         for(int i=0; i<n; i++){
-            Sample smp = samplesAveraged.at(i);
+            const Sample& smp = samplesAveraged.at(i);
             Location loc = smp.location();
             Beacons beacons = smp.beacons();
             // convert to X
@@ -398,91 +533,130 @@ namespace loc{
         // Compute dY = Y - m(X)
         Eigen::MatrixXd dY(n, m);
         for(int i=0; i<n; i++){
-            Sample smp = samplesAveraged.at(i);
+            const Sample& smp = samplesAveraged.at(i);
             Location loc = smp.location();
             for(int j=0; j<m; j++){
-                BLEBeacon bleBeacon = mBLEBeacons.at(j);
+                const BLEBeacon& bleBeacon = mBLEBeacons.at(j);
                 const auto& id = bleBeacon.id();
-                auto features = mITUModelMap[id].transformFeature(loc, bleBeacon);
-                std::vector<double> params = mITUParameters.at(j);
-                double ymean = mITUModelMap[id].predict(params, features);
+                const ITUModelFunction& ituModel = mITUModelMap.at(id);
+                auto features = ituModel.transformFeature(loc, bleBeacon);
+                const std::vector<double>& params = mITUParameters.at(j);
+                double ymean = ituModel.predict(params, features);
                 dY(i, j)=Y(i,j)-ymean;
             }
         }
-        
-        // Training with selection of kernel parameters
-        mGP->fitCV(X, dY, Actives);
-        
-        // Estimate variance parameter (sigma_n) by using raw (=not averaged) data
-        auto rssiStandardDeviationsTemp = computeRssiStandardDeviations(samples);
+        return std::make_tuple(X, dY, Actives);
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::updateRssiStandardDeviations(){
+        auto rssiStandardDeviationsTemp = computeRssiStandardDeviations();
         std::vector<int> rssiCounts = std::get<0>(rssiStandardDeviationsTemp);
         auto RssiStdevs = std::get<1>(rssiStandardDeviationsTemp);
         auto RssiStdevGammas = std::get<2>(rssiStandardDeviationsTemp);
         
+        // beacons without samples keep their current stdevs (e.g. appended to a loaded model)
+        bool keepsCurrent = mRssiStandardDeviations.size()==mBLEBeacons.size();
+        std::vector<double> stdevs = mStdSmooth? RssiStdevGammas : RssiStdevs;
+        for(int i=0; i<stdevs.size(); i++){
+            if(keepsCurrent && rssiCounts.at(i)==0){
+                stdevs[i] = mRssiStandardDeviations.at(i);
+            }
+        }
+        mRssiStandardDeviations = stdevs;
+        
         if(!mStdSmooth){
-            mRssiStandardDeviations = RssiStdevs;
             for(auto& ble: mBLEBeacons){
                 const auto& id = ble.id();
                 int index = mBeaconIdIndexMap.at(id); // id = 0,1,2,..,mBLEBeacons.size()-1
                 std::cout << "stdev(" << ble.uuid() << "," << ble.major() << "," << ble.minor() << ") = " << mRssiStandardDeviations.at(index) << "(n=" << rssiCounts.at(index) << ")" << std::endl;
             }
         }else{
-            mRssiStandardDeviations = RssiStdevGammas;
             for(auto& ble: mBLEBeacons){
                 const auto& id = ble.id();
                 int index = mBeaconIdIndexMap.at(id); // id = 0,1,2,..,mBLEBeacons.size()-1
                 std::cout << "stdevMMSE(" << ble.uuid() << "," << ble.major() << "," << ble.minor() << ") = " << mRssiStandardDeviations.at(index) << "(n=" << rssiCounts.at(index) << "), stdev=" << RssiStdevs.at(index) << std::endl;
             }
         }
-        
-        if(mStdevRssiForUnknownBeacon==0){
-            mStdevRssiForUnknownBeacon = computeNormalStandardDeviation(mRssiStandardDeviations);
-        }
-        
-        return *this;
     }
     
-    // compute standard deviation of RSSI for each ble beacon
+    // accumulate square errors of RSSI for each ble beacon
     template<class Tstate, class Tinput>
-    std::tuple<std::vector<int>, std::vector<double>, std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeRssiStandardDeviations(Samples samples){
-
-        std::map<int, int> indexCount;
-        std::map<int, double> indexRssiSum;
-        for(auto iter=mBeaconIdIndexMap.begin(); iter!=mBeaconIdIndexMap.end(); iter++){
-            int index = iter->second;
-            indexCount[index] = 0;
-            indexRssiSum[index] = 0;
-        }
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::accumulateRssiSquareErrors(const std::vector<AggregatedSample>& aggregatedSamples){
         
-        for(Sample smp: samples){
-            Location loc = smp.location();
-            Beacons bs = smp.beacons();
+        // Raw samples at the same location share the prediction, so square errors are computed from their statistics.
+        // Samples are processed in blocks so that GP residuals are predicted at once for each block.
+        // Partial sums of blocks are added in order to keep the result independent of the number of threads.
+        const int blockSize = (int) GaussianProcess::batchBlockSize;
+        int nSamples = (int) aggregatedSamples.size();
+        int nBlocks = (nSamples + blockSize - 1)/blockSize;
+        size_t m = mBLEBeacons.size();
+        std::vector<std::vector<int>> blockCounts(nBlocks, std::vector<int>(m, 0));
+        std::vector<std::vector<double>> blockSquareErrorSums(nBlocks, std::vector<double>(m, 0.0));
+        
+        ArrayUtils::parallelFor(nBlocks, mNumTrainingThreads, [&](int blk){
+            int begin = blk*blockSize;
+            int end = std::min(nSamples, begin + blockSize);
             
-            std::vector<double> xvec = MLAdapter::locationToVec(loc);
-            std::vector<int> indices = extractKnownBeaconIndices(bs);
-            std::vector<double> dypreds = mGP->predict(xvec.data(), indices);
+            // union of beacons observed in the block
+            std::vector<int> blockIndices;
+            for(int s=begin; s<end; s++){
+                for(const auto& pair: aggregatedSamples.at(s).beaconStatistics){
+                    if(mBeaconIdIndexMap.count(pair.first)==1){
+                        blockIndices.push_back(mBeaconIdIndexMap.at(pair.first));
+                    }
+                }
+            }
+            std::sort(blockIndices.begin(), blockIndices.end());
+            blockIndices.erase(std::unique(blockIndices.begin(), blockIndices.end()), blockIndices.end());
+            std::vector<int> columns(m, -1);
+            for(int c=0; c<blockIndices.size(); c++){
+                columns[blockIndices[c]] = c;
+            }
             
-            int i = 0;
-            for(const Beacon& b: bs){
-                const auto& id = b.id();
-                int index = mBeaconIdIndexMap.at(id);
-                BLEBeacon ble = mBLEBeacons.at(index);
-                std::vector<double> features = mITUModelMap[id].transformFeature(loc, ble);
-                std::vector<double> params = mITUParameters.at(index);
-                double mean = mITUModelMap[id].predict(params, features);
-                
-                double dypred = dypreds.at(i);
-                double ypred = mean + dypred;
-                double rssi = b.rssi();
-                double difference = rssi - ypred;
-                
-                indexCount[index] += 1;
-                indexRssiSum[index] += difference*difference;
-                
-                i++;
+            Eigen::MatrixXd Xstar(end-begin, ITUModelFunction::ndim_);
+            for(int s=begin; s<end; s++){
+                const Location& loc = aggregatedSamples.at(s).location;
+                Xstar.row(s-begin) << loc.x(), loc.y(), loc.z(), loc.floor();
             }
+            Eigen::MatrixXd dYpreds = mGP->predict(Xstar, blockIndices);
             
+            auto& counts = blockCounts[blk];
+            auto& squareErrorSums = blockSquareErrorSums[blk];
+            for(int s=begin; s<end; s++){
+                const AggregatedSample& aggregatedSample = aggregatedSamples.at(s);
+                const Location& loc = aggregatedSample.location;
+                for(const auto& pair: aggregatedSample.beaconStatistics){
+                    const auto& id = pair.first;
+                    if(mBeaconIdIndexMap.count(id)==0){
+                        continue;
+                    }
+                    int index = mBeaconIdIndexMap.at(id);
+                    const BLEBeacon& ble = mBLEBeacons.at(index);
+                    const ITUModelFunction& ituModel = mITUModelMap.at(id);
+                    std::vector<double> features = ituModel.transformFeature(loc, ble);
+                    double mean = ituModel.predict(mITUParameters.at(index), features);
+                    
+                    double dypred = dYpreds(s-begin, columns[index]);
+                    double ypred = mean + dypred;
+                    
+                    counts[index] += pair.second.count;
+                    squareErrorSums[index] += pair.second.squareErrorSum(ypred);
+                }
+            }
+        });
+        
+        for(int blk=0; blk<nBlocks; blk++){
+            for(int index=0; index<m; index++){
+                mRssiCounts[index] += blockCounts[blk][index];
+                mRssiSquareErrorSums[index] += blockSquareErrorSums[blk][index];
+            }
         }
+    }
+    
+    // compute standard deviation of RSSI for each ble beacon
+    template<class Tstate, class Tinput>
+    std::tuple<std::vector<int>, std::vector<double>, std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeRssiStandardDeviations() const{
         
         std::vector<int> counts;
         std::vector<double> stdevs;
@@ -490,12 +664,12 @@ namespace loc{
         for(auto& ble: mBLEBeacons){
             const auto& id = ble.id();
             int index = mBeaconIdIndexMap.at(id);
-            double var = indexRssiSum[index] /(indexCount[index]);
-            double varGamma = (indexRssiSum[index] + 2.0*mGammaLmd)/(indexCount[index] + 2.0*mGammaK);
+            double var = mRssiSquareErrorSums.at(index) /(mRssiCounts.at(index));
+            double varGamma = (mRssiSquareErrorSums.at(index) + 2.0*mGammaLmd)/(mRssiCounts.at(index) + 2.0*mGammaK);
             if (isnan(var)) {
                 std::cerr << "Stdev is NaN for beacon(" << ble.id().toString() << ")" << std::endl;
             }
-            counts.push_back(indexCount[index]);
+            counts.push_back(mRssiCounts.at(index));
             double stdev = sqrt(var);
             stdevs.push_back(stdev);
             stdevGammas.push_back(std::sqrt(varGamma));
@@ -547,12 +721,19 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     std::map<BeaconId, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predict(const Tstate& state, const Tinput& input) const{
-        //Assuming Tinput = Beacons
-        std::map<BeaconId, NormalParameter> beaconIdRssiStatsMap;
-        
+        if(mRssiRaster && mRssiRaster->contains(state)){
+            return predictFromRaster(state, input);
+        }
         std::vector<double> xvec = MLAdapter::locationToVec(state);
         std::vector<int> indices = extractKnownBeaconIndices(input);
         std::vector<double> dypreds = mGP->predict(xvec.data(), indices);
+        return predict(state, input, dypreds);
+    }
+    
+    template<class Tstate, class Tinput>
+    std::map<BeaconId, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predict(const Tstate& state, const Tinput& input, const std::vector<double>& dypreds) const{
+        //Assuming Tinput = Beacons
+        std::map<BeaconId, NormalParameter> beaconIdRssiStatsMap;
         
         int idx_local=0;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
@@ -587,6 +768,26 @@ namespace loc{
     }
     
     
+    template<class Tstate, class Tinput>
+    std::map<BeaconId, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predictFromRaster(const Tstate& state, const Tinput& input) const{
+        std::map<BeaconId, NormalParameter> beaconIdRssiStatsMap;
+        for(auto iter=input.begin(); iter!=input.end(); iter++){
+            const auto& id = iter->id();
+            if(mBeaconIdIndexMap.count(id)==1){
+                int idx_global = mBeaconIdIndexMap.at(id);
+                const BLEBeacon& bleBeacon = mBLEBeacons.at(idx_global);
+                
+                double ypred = mRssiRaster->interpolate(state, idx_global);
+                double stdev = mRssiStandardDeviations[idx_global];
+                if(mCoeffDiffFloorStdev!=1.0 && Location::checkDifferentFloor(state, bleBeacon)){
+                    stdev = stdev*mCoeffDiffFloorStdev ;
+                }
+                beaconIdRssiStatsMap[id] = NormalParameter(ypred, stdev);
+            }
+        }
+        return beaconIdRssiStatsMap;
+    }
+    
     template<class Tstate, class Tinput>
     double GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihood(const Tstate& state, const Tinput& input){
         std::vector<double> values = this->computeLogLikelihoodRelatedValues(state, input);
@@ -595,23 +796,26 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input){
+        return computeLogLikelihoodRelatedValues(state, state.timestamp, state.history, input);
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, long timestamp, const boost::circular_buffer<State>& history, const Tinput& input){
         //Assuming Tinput = Beacons
         
-        std::vector<double> returnValues(4); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
-        
         std::map<BeaconId, NormalParameter> beaconIdRssiStatsMap;
         // delayed prdiction
         int T = mTDelay;
         double dTmin = mDTDelay - mDTDelayMargin; //ms
         double dTmax = mDTDelay + mDTDelayMargin; //ms
         if(T==1){
-            beaconIdRssiStatsMap = this->predict(state, input);
+            return computeLogLikelihoodRelatedValues(state, compileObservation(input));
         }else{
-            long headTS = state.timestamp;
+            long headTS = timestamp;
             std::vector<State> statesConsider;
-            auto hsize = state.history.size();
+            auto hsize = history.size();
             for(int i=0; i<hsize; i++){
-                const State& hState = state.history.at(hsize-i-1);
+                const State& hState = history.at(hsize-i-1);
                 long diffTS = headTS - hState.timestamp;
                 if( dTmin <= diffTS && diffTS<dTmax){
                     headTS = hState.timestamp;
@@ -648,6 +852,13 @@ namespace loc{
             }
             beaconIdRssiStatsMap = meanStatsMap;
         }
+        return computeLogLikelihoodRelatedValues(state, beaconIdRssiStatsMap, input);
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const std::map<BeaconId, NormalParameter>& beaconIdRssiStatsMap, const Tinput& input) const{
+        
+        std::vector<double> returnValues(4); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
         
         std::vector<int> indices = extractKnownBeaconIndices(input);
         
@@ -673,7 +884,7 @@ namespace loc{
             
             // RSSI of known beacons are predicted by a model.
             if(mBeaconIdIndexMap.count(id)==1){
-                auto rssiStats = beaconIdRssiStatsMap[id];
+                const auto& rssiStats = beaconIdRssiStatsMap.at(id);
                 double ypred = rssiStats.mean();
                 double stdev = rssiStats.stdev();
                 
@@ -683,7 +894,7 @@ namespace loc{
                 
                 if(applyLowestLogLikelihood){
                     double enlargedStdev = mStdevRssiForUnknownBeacon * mCoeffDiffFloorStdev;
-                    int idx = mBeaconIdIndexMap[b.id()];
+                    int idx = mBeaconIdIndexMap.at(b.id());
                     auto ble = mBLEBeacons.at(idx);
                     if(ble.floor()!=state.floor()){
                         double lowestlogLL = normFunc(0, 0, enlargedStdev);
@@ -716,12 +927,116 @@ namespace loc{
         return returnValues;
     }
     
+    template<class Tstate, class Tinput>
+    typename GaussianProcessLDPLMultiModel<Tstate, Tinput>::CompiledObservation GaussianProcessLDPLMultiModel<Tstate, Tinput>::compileObservation(const Tinput& input) const{
+        CompiledObservation observation;
+        observation.rssis.reserve(input.size());
+        observation.knownIndices.reserve(input.size());
+        for(auto iter=input.begin(); iter!=input.end(); iter++){
+            observation.rssis.push_back(iter->rssi());
+            auto itr = mBeaconIdIndexMap.find(iter->id());
+            if(itr==mBeaconIdIndexMap.end()){
+                observation.knownIndices.push_back(-1);
+                continue;
+            }
+            int idx_global = itr->second;
+            observation.knownIndices.push_back(static_cast<int>(observation.indices.size()));
+            observation.indices.push_back(idx_global);
+            observation.stdevs.push_back(mRssiStandardDeviations[idx_global]);
+            observation.beacons.push_back(&mBLEBeacons.at(idx_global));
+            observation.ituModels.push_back(&mITUModelMap.at(iter->id()));
+            observation.ituParameters.push_back(mITUParameters.at(idx_global).data());
+        }
+        if(observation.indices.size()==0){
+            std::cout << "ObservationModel does not know the input data." << std::endl;
+        }
+        return observation;
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const CompiledObservation& observation) const{
+        if(mRssiRaster && mRssiRaster->contains(state)){
+            return computeLogLikelihoodRelatedValues(state, observation, nullptr);
+        }
+        std::vector<double> xvec = MLAdapter::locationToVec(state);
+        std::vector<double> dypreds = mGP->predict(xvec.data(), observation.indices);
+        return computeLogLikelihoodRelatedValues(state, observation, dypreds.data());
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const CompiledObservation& observation, const double dypreds[]) const{
+        
+        std::vector<double> returnValues(4); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
+        
+        double rssiBias = 0;
+        const State* pState = dynamic_cast<const State*>(&state);
+        if(pState){
+            rssiBias = pState->rssiBias();
+        }
+        
+        double features[ITUModelFunction::ndim_];
+        double jointLogLL = 0;
+        double sumMahaDist = 0;
+        for(size_t j=0; j<observation.rssis.size(); j++){
+            double rssi = observation.rssis[j] - rssiBias;
+            int k = observation.knownIndices[j];
+            
+            // RSSI of known beacons are predicted by a model.
+            if(0<=k){
+                const BLEBeacon& bleBeacon = *observation.beacons[k];
+                double ypred;
+                if(dypreds){
+                    observation.ituModels[k]->transformFeature(state, bleBeacon, features);
+                    ypred = observation.ituModels[k]->predict(observation.ituParameters[k], features) + dypreds[k];
+                }else{
+                    ypred = mRssiRaster->interpolate(state, observation.indices[k]);
+                }
+                double stdev = observation.stdevs[k];
+                if(mCoeffDiffFloorStdev!=1.0 && Location::checkDifferentFloor(state, bleBeacon)){
+                    stdev = stdev*mCoeffDiffFloorStdev ;
+                }
+                
+                double logLL = normFunc(rssi, ypred, stdev);
+                double mahaDist = MathUtils::mahalanobisDistance(rssi, ypred, stdev);
+                
+                if(applyLowestLogLikelihood){
+                    double enlargedStdev = mStdevRssiForUnknownBeacon * mCoeffDiffFloorStdev;
+                    if(bleBeacon.floor()!=state.floor()){
+                        double lowestlogLL = normFunc(0, 0, enlargedStdev);
+                        logLL = lowestlogLL < logLL? logLL : lowestlogLL;
+                    }
+                }
+                
+                jointLogLL += logLL;
+                sumMahaDist += mahaDist;
+            }
+            // RSSI of unknown beacons are assumed to be minRssi.
+            else if(mFillsUnknownBeaconRssi){
+                double ypred = BeaconConfig::minRssi();
+                double stdev = mStdevRssiForUnknownBeacon;
+                
+                double logLL = normFunc(rssi, ypred, stdev);
+                double mahaDist = MathUtils::mahalanobisDistance(rssi, ypred, stdev);
+                
+                jointLogLL += logLL;
+                sumMahaDist += mahaDist;
+            }
+        }
+        returnValues[0] = jointLogLL;
+        returnValues[1] = sumMahaDist;
+        returnValues[2] = observation.indices.size();
+        returnValues[3] = observation.rssis.size() - observation.indices.size();
+        
+        return returnValues;
+    }
+    
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihood(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
         std::vector<double> logLLs(n);
+        std::vector<std::vector<double>> values = this->computeLogLikelihoodRelatedValues(states, input);
         for(int i=0; i<n; i++){
-            logLLs[i] = this->computeLogLikelihood(states.at(i), input);
+            logLLs[i] = values[i].at(0);
         }
         return logLLs;
     }
@@ -729,12 +1044,55 @@ namespace loc{
     template<class Tstate, class Tinput>
     std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
-        std::vector<double> logLLs(n);
-        
         std::vector<std::vector<double>> values(n);
-        for(int i=0; i<n; i++){
+        if(mTDelay==1){
+            const CompiledObservation observation = compileObservation(input);
+            if(!mRssiRaster){
+                // Predict GP residuals for all states at once (column i: residuals for state i)
+                Eigen::MatrixXd dYpredsT = mGP->predict(MLAdapter::locationsToMat(states), observation.indices).transpose();
+                likelihoodThreadPool().parallelFor(n, [&](int i){
+                    values[i] = this->computeLogLikelihoodRelatedValues(states[i], observation, dYpredsT.col(i).data());
+                });
+            }else{
+                likelihoodThreadPool().parallelFor(n, [&](int i){
+                    values[i] = this->computeLogLikelihoodRelatedValues(states[i], observation);
+                });
+            }
+            return values;
+        }
+        likelihoodThreadPool().parallelFor(n, [&](int i){
             values[i] = this->computeLogLikelihoodRelatedValues(states.at(i), input);
+        });
+        return values;
+    }
+    
+    template<class Tstate, class Tinput>
+    std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const StatesSoA & states, const Tinput & input) {
+        int n = (int) states.size();
+        std::vector<std::vector<double>> values(n);
+        if(mTDelay==1){
+            const CompiledObservation observation = compileObservation(input);
+            if(!mRssiRaster){
+                // Predict GP residuals for all states at once (column i: residuals for state i)
+                Eigen::MatrixXd X(n, 4);
+                X.col(0) = Eigen::Map<const Eigen::VectorXd>(states.x.data(), n);
+                X.col(1) = Eigen::Map<const Eigen::VectorXd>(states.y.data(), n);
+                X.col(2) = Eigen::Map<const Eigen::VectorXd>(states.z.data(), n);
+                X.col(3) = Eigen::Map<const Eigen::VectorXd>(states.floor.data(), n);
+                Eigen::MatrixXd dYpredsT = mGP->predict(X, observation.indices).transpose();
+                likelihoodThreadPool().parallelFor(n, [&](int i){
+                    values[i] = this->computeLogLikelihoodRelatedValues(states.at(i), observation, dYpredsT.col(i).data());
+                });
+            }else{
+                likelihoodThreadPool().parallelFor(n, [&](int i){
+                    values[i] = this->computeLogLikelihoodRelatedValues(states.at(i), observation);
+                });
+            }
+            return values;
         }
+        likelihoodThreadPool().parallelFor(n, [&](int i){
+            values[i] = this->computeLogLikelihoodRelatedValues(states.at(i), states.timestamp[i], states.history[i], input);
+        });
         return values;
     }
     
@@ -773,6 +1131,129 @@ namespace loc{
         return *this;
     }
     
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::numThreads(int nThreads){
+        mNumThreads = nThreads;
+        mThreadPool.reset();
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    int GaussianProcessLDPLMultiModel<Tstate, Tinput>::numThreads() const{
+        return mNumThreads;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::threadPool(ThreadPool::Ptr threadPool){
+        mThreadPool = threadPool;
+        mNumThreads = threadPool ? threadPool->numThreads() : 1;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    ThreadPool& GaussianProcessLDPLMultiModel<Tstate, Tinput>::likelihoodThreadPool(){
+        if(!mThreadPool){
+            mThreadPool = std::make_shared<ThreadPool>(mNumThreads);
+        }
+        return *mThreadPool;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::numTrainingThreads(int nThreads){
+        mNumTrainingThreads = nThreads;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    int GaussianProcessLDPLMultiModel<Tstate, Tinput>::numTrainingThreads() const{
+        return mNumTrainingThreads;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::trainingMemoryLimit(size_t memoryLimit){
+        mTrainingMemoryLimit = memoryLimit;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    size_t GaussianProcessLDPLMultiModel<Tstate, Tinput>::trainingMemoryLimit() const{
+        return mTrainingMemoryLimit;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::cutoffRadius(double cutoffRadius){
+        mGP->cutoffRadius(cutoffRadius);
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::buildRssiRaster(double cellSize, double margin){
+        if(mBLEBeacons.size()==0){
+            BOOST_THROW_EXCEPTION(LocException("BLE beacons are not set."));
+        }
+        if(cellSize<=0){
+            BOOST_THROW_EXCEPTION(LocException("cellSize must be positive."));
+        }
+        
+        // Area covering all beacons
+        double xmin = std::numeric_limits<double>::max();
+        double ymin = std::numeric_limits<double>::max();
+        double xmax = std::numeric_limits<double>::lowest();
+        double ymax = std::numeric_limits<double>::lowest();
+        std::set<int> floors;
+        for(const auto& ble: mBLEBeacons){
+            xmin = std::min(xmin, ble.x());
+            ymin = std::min(ymin, ble.y());
+            xmax = std::max(xmax, ble.x());
+            ymax = std::max(ymax, ble.y());
+            floors.insert((int) std::round(ble.floor()));
+        }
+        xmin -= margin;
+        ymin -= margin;
+        int nx = std::max(2, (int) std::ceil((xmax + margin - xmin)/cellSize) + 1);
+        int ny = std::max(2, (int) std::ceil((ymax + margin - ymin)/cellSize) + 1);
+        int nBeacons = (int) mBLEBeacons.size();
+        
+        auto raster = std::make_shared<RssiRaster>(xmin, ymin, cellSize, nx, ny, nBeacons);
+        std::vector<int> indices(nBeacons);
+        std::iota(indices.begin(), indices.end(), 0);
+        
+        for(int floor: floors){
+            raster->allocate(floor);
+            ArrayUtils::parallelFor(ny, mNumThreads, [&](int iy){
+                std::vector<Location> locs(nx);
+                for(int ix=0; ix<nx; ix++){
+                    locs[ix] = raster->location(ix, iy, floor);
+                }
+                Eigen::MatrixXd dYpreds = mGP->predict(MLAdapter::locationsToMat(locs), indices);
+                for(int ix=0; ix<nx; ix++){
+                    float* values = raster->values(ix, iy, floor);
+                    for(int j=0; j<nBeacons; j++){
+                        const BLEBeacon& bleBeacon = mBLEBeacons.at(j);
+                        const auto& ituModel = mITUModelMap.at(bleBeacon.id());
+                        const auto& features = ituModel.transformFeature(locs[ix], bleBeacon);
+                        double mean = ituModel.predict(mITUParameters.at(j), features);
+                        values[j] = (float) (mean + dYpreds(ix, j));
+                    }
+                }
+            });
+        }
+        mRssiRaster = raster;
+        std::cout << "RSSI raster: " << nx << "x" << ny << " grid points (cellSize=" << cellSize << ") on " << floors.size() << " floors" << std::endl;
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::clearRssiRaster(){
+        mRssiRaster.reset();
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    bool GaussianProcessLDPLMultiModel<Tstate, Tinput>::usesRssiRaster() const{
+        return mRssiRaster!=nullptr;
+    }
+    
     // CEREAL function
     template<class Tstate, class Tinput>
     template<class Archive>
@@ -806,6 +1287,9 @@ namespace loc{
         if(version <= 1){
             ar(cereal::make_nvp("mGP",*mGP));
         }else if(version <= 2){
+            if(std::dynamic_pointer_cast<GaussianProcessFITC>(mGP)){
+                BOOST_THROW_EXCEPTION(LocException("GPFITC cannot be saved in version " + std::to_string(version) + " (version>=" + std::to_string(FITC_SUPPORTED_MIN_VERSION) + " is required)"));
+            }
             auto lgp = std::dynamic_pointer_cast<GaussianProcessLight>(mGP);
             if(lgp){
                 ar(cereal::make_nvp("GaussianProcessLight", *lgp));
@@ -818,6 +1302,9 @@ namespace loc{
             if(gpType == GPType::GPLIGHT){
                 auto lgp = std::dynamic_pointer_cast<GaussianProcessLight>(mGP);
                 ar(cereal::make_nvp("GaussianProcessLight", *lgp));
+            } else if (gpType == GPType::GPFITC) {
+                auto fgp = std::dynamic_pointer_cast<GaussianProcessFITC>(mGP);
+                ar(cereal::make_nvp("GaussianProcessFITC", *fgp));
             } else if (gpType == GPType::GPNORMAL) {
                 ar(cereal::make_nvp("GaussianProcess", *mGP));
             }
@@ -879,6 +1366,7 @@ namespace loc{
             try{
                 GaussianProcessLight lgp;
                 ar(cereal::make_nvp("GaussianProcessLight", lgp));
+                lgp.buildClusterLookupGrid();
                 this->mGP = std::make_shared<GaussianProcessLight>(lgp);
                 this->gpType = GPType::GPLIGHT;
             }catch(cereal::Exception& e){
@@ -892,7 +1380,12 @@ namespace loc{
             if(gpType == GPType::GPLIGHT){
                 GaussianProcessLight lgp;
                 ar(cereal::make_nvp("GaussianProcessLight", lgp));
+                lgp.buildClusterLookupGrid();
                 this->mGP = std::make_shared<GaussianProcessLight>(lgp);
+            }else if (gpType == GPType::GPFITC) {
+                GaussianProcessFITC fgp;
+                ar(cereal::make_nvp("GaussianProcessFITC", fgp));
+                this->mGP = std::make_shared<GaussianProcessFITC>(fgp);
             }else if (gpType == GPType::GPNORMAL) {
                 GaussianProcess gp;
                 ar(cereal::make_nvp("GaussianProcess", gp));
@@ -1005,6 +1498,9 @@ namespace loc{
         if(1<nUUID && version < MULTIUUID_SUPPORTED_MIN_VERSION){
             version = MULTIUUID_SUPPORTED_MIN_VERSION;
         }
+        if(gpType==GPFITC && version < FITC_SUPPORTED_MIN_VERSION){
+            version = FITC_SUPPORTED_MIN_VERSION;
+        }
     }
     
     /**
@@ -1013,24 +1509,31 @@ namespace loc{
     template<class Tstate, class Tinput>
     GaussianProcessLDPLMultiModel<Tstate, Tinput>* GaussianProcessLDPLMultiModelTrainer<Tstate, Tinput>::train(){
         
-        Samples samples = mDataStore->getSamples();
         BLEBeacons bleBeacons = mDataStore->getBLEBeacons();
         if(bleBeacons.size()<=0){
             BOOST_THROW_EXCEPTION(LocException("BLEBeacons have not been set to dataStore."));
         }
-        Samples samplesFiltered;
-        try{
-            samplesFiltered = Sample::filterUnregisteredBeacons(samples, bleBeacons);
-        }catch(LocException& ex) {
-            throw ex;
+        // raw samples are aggregated unless the data store has aggregated them on ingestion
+        SampleAggregator aggregator;
+        const SampleAggregator* storedAggregator = mDataStore->getSampleAggregator();
+        if(storedAggregator==nullptr){
+            aggregator.add(mDataStore->getSamples());
+            storedAggregator = &aggregator;
         }
+        SampleAggregator aggregatorFiltered = storedAggregator->filterUnregisteredBeacons(bleBeacons);
+        aggregator = SampleAggregator();
+        
         GaussianProcessLDPLMultiModel<Tstate, Tinput>* obsModel = new GaussianProcessLDPLMultiModel<Tstate, Tinput>();
         
         obsModel->gpType = gpType;
         obsModel->matType = matType;
+        obsModel->numTrainingThreads(numThreads);
+        obsModel->trainingMemoryLimit(trainingMemoryLimit);
+        obsModel->mNumInducingPoints = numInducingPoints;
+        obsModel->mInducingPointPlacement = inducingPointPlacement;
         
         obsModel->bleBeacons(bleBeacons);
-        obsModel->train(samplesFiltered);
+        obsModel->train(aggregatorFiltered);
         
         return obsModel;
     }
@@ -31,8 +31,10 @@
 #include "bleloc.h"
 #include "KernelFunction.hpp"
 #include "GaussianProcess.hpp"
+#include "GaussianProcessFITC.hpp"
 #include "ObservationModel.hpp"
 #include "ObservationModelTrainer.hpp"
+#include "ArrayUtils.hpp"
 
 namespace loc{
     
@@ -42,7 +44,8 @@ namespace loc{
     
     enum GPType{
         GPNORMAL,
-        GPLIGHT
+        GPLIGHT,
+        GPFITC
     };
     
     class ITUModelFunction{
@@ -56,7 +59,7 @@ namespace loc{
         int ndim(){return ndim_;}
         
         ITUModelFunction& distanceOffset(double distanceOffset);
-        //void transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double features[]) const;
+        void transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double features[]) const;
         std::vector<double> transformFeature(const Location& stateReceiver, const Location& stateTransmitter) const;
         double predict(const double parameters[], const double features[]) const;
         double predict(const std::vector<double>& parameters, const std::vector<double>& features) const;
@@ -65,6 +68,38 @@ namespace loc{
         void serialize(Archive& ar);
     };
     
+    /**
+      Predicted mean RSSI of beacons on a regular grid on each floor
+     **/
+    class RssiRaster{
+    private:
+        double x0_ = 0;
+        double y0_ = 0;
+        double cellSize_ = 1.0;
+        int nx_ = 0;
+        int ny_ = 0;
+        int nBeacons_ = 0;
+        std::map<int, std::vector<float>> values_; // floor -> [iy][ix][beacon index]
+        
+    public:
+        using Ptr = std::shared_ptr<RssiRaster>;
+        
+        RssiRaster() = default;
+        RssiRaster(double x0, double y0, double cellSize, int nx, int ny, int nBeacons);
+        
+        int nx() const;
+        int ny() const;
+        // location of a grid point
+        Location location(int ix, int iy, int floor) const;
+        void allocate(int floor);
+        // values of a grid point on an allocated floor
+        float* values(int ix, int iy, int floor);
+        
+        bool contains(const Location& location) const;
+        // bilinear interpolation of predicted mean RSSI
+        double interpolate(const Location& location, int beaconIndex) const;
+    };
+    
     /**
       GaussianProcess based model
      **/
@@ -84,7 +119,7 @@ namespace loc{
     class GaussianProcessLDPLMultiModelTrainer;
     
     template<class Tstate, class Tinput>
-    class GaussianProcessLDPLMultiModel : public ObservationModel<Tstate, Tinput>{
+    class GaussianProcessLDPLMultiModel : public ObservationModel<Tstate, Tinput>, public ObservationModelSoA<Tinput>{
     private:
 
         GaussianProcessLDPLMultiModelParameters trainParams;
@@ -102,6 +137,11 @@ namespace loc{
         std::map<BeaconId, int> mBeaconIdIndexMap;
         //boost::bimaps::bimap<long, int> mBeaconIdIndexBimap;
         std::vector<double> mRssiStandardDeviations;
+        // sufficient statistics of RSSI errors in training (not serialized)
+        std::vector<int> mRssiCounts;
+        std::vector<double> mRssiSquareErrorSums;
+        // pseudo-count of samples behind the current stdevs when the statistics are not available (e.g. loaded model)
+        int mRssiPriorCount = 100;
         bool mFillsUnknownBeaconRssi = false;
         double mStdevRssiForUnknownBeacon = 0.0;
         double computeNormalStandardDeviation(std::vector<double> standardDeviations);
@@ -110,18 +150,47 @@ namespace loc{
         // Private function to train the model
         //GaussianProcessLDPLMultiModel& kernelFunction(std::shared_ptr<KernelFunction> kernel);
         GaussianProcessLDPLMultiModel& bleBeacons(BLEBeacons bleBeacons);
-        GaussianProcessLDPLMultiModel& train(Samples samples);
-        std::vector<std::vector<double>> fitITUModel(Samples samples);
-        std::tuple<std::vector<int>, std::vector<double>, std::vector<double>> computeRssiStandardDeviations(Samples samples);
+        GaussianProcessLDPLMultiModel& train(const SampleAggregator& aggregator);
+        std::vector<std::vector<double>> fitITUModel(const std::vector<Sample>& samplesAveraged);
+        std::tuple<Eigen::MatrixXd, Eigen::MatrixXd, Eigen::MatrixXd> computeResidualMatrices(const std::vector<Sample>& samplesAveraged) const;
+        void accumulateRssiSquareErrors(const std::vector<AggregatedSample>& aggregatedSamples);
+        std::tuple<std::vector<int>, std::vector<double>, std::vector<double>> computeRssiStandardDeviations() const;
+        void updateRssiStandardDeviations();
         std::vector<int> extractKnownBeaconIndices(const Tinput& beacons) const;
+        std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, long timestamp, const boost::circular_buffer<State>& history, const Tinput& input);
+        std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const std::map<BeaconId, NormalParameter>& beaconIdRssiStatsMap, const Tinput& input) const;
+        // predict mean and stdev given state and GP residuals of known beacons in input
+        std::map<BeaconId, NormalParameter> predict(const Tstate& state, const Tinput& input, const std::vector<double>& dypreds) const;
+        std::map<BeaconId, NormalParameter> predictFromRaster(const Tstate& state, const Tinput& input) const;
+        
+        // Input beacons resolved once per observation into flat arrays
+        struct CompiledObservation{
+            std::vector<double> rssis; // RSSI of all input beacons
+            std::vector<int> knownIndices; // index in arrays for known beacons below (-1: unknown beacon)
+            // known beacons
+            std::vector<int> indices; // global beacon index
+            std::vector<double> stdevs;
+            std::vector<const BLEBeacon*> beacons;
+            std::vector<const ITUModelFunction*> ituModels;
+            std::vector<const double*> ituParameters;
+        };
+        CompiledObservation compileObservation(const Tinput& input) const;
+        std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const CompiledObservation& observation) const;
+        // dypreds: GP residuals of known beacons (nullptr: predicted mean RSSI is read from mRssiRaster)
+        std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const CompiledObservation& observation, const double dypreds[]) const;
         
         friend class GaussianProcessLDPLMultiModelTrainer<Tstate, Tinput>;
         int version = 2;
 
         const int MULTIUUID_SUPPORTED_MIN_VERSION = 3;
         const int BINARY_SUPPORTED_MIN_VERSION = 3;
+        // GPFITC is written only with ModelType (version 3)
+        const int FITC_SUPPORTED_MIN_VERSION = 3;
         GPType gpType = GPNORMAL;
         MatType matType = DENSE;
+        // inducing points of GPFITC
+        int mNumInducingPoints = 400;
+        GaussianProcessFITC::InducingPointPlacement mInducingPointPlacement = GaussianProcessFITC::KMEANS;
         
         //parameters for delayed prediction
         int mTDelay = 1;
@@ -132,6 +201,20 @@ namespace loc{
         bool mStdSmooth = false;
         double mGammaK = 0.0;
         double mGammaLmd = 0.0;
+        
+        // number of threads to evaluate likelihoods of particles (<=0: hardware concurrency)
+        int mNumThreads = 1;
+        ThreadPool::Ptr mThreadPool;
+        // number of threads to train the model (<=0: hardware concurrency)
+        int mNumTrainingThreads = 0;
+        // bytes held at once by local models of GPLIGHT fitted in parallel (0: half of physical memory)
+        size_t mTrainingMemoryLimit = 0;
+        
+        // precomputed prediction (optional)
+        RssiRaster::Ptr mRssiRaster;
+        
+        // Workers to evaluate likelihoods (created on first use unless shared by threadPool())
+        ThreadPool& likelihoodThreadPool();
 
     public:
         GaussianProcessLDPLMultiModel() = default;
@@ -154,6 +237,15 @@ namespace loc{
         
         std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input);
         std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input) override;
+        std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const StatesSoA & states, const Tinput& input) override;
+        
+        // Append survey samples to the trained model keeping ITU and kernel parameters fixed.
+        // The GP is updated incrementally and the stdevs of RSSI are refreshed.
+        GaussianProcessLDPLMultiModel& appendSamples(const Samples& samples);
+        GaussianProcessLDPLMultiModel& appendSamples(const SampleAggregator& aggregator);
+        // Samples the current stdevs are weighted as when appending to a loaded model
+        GaussianProcessLDPLMultiModel& rssiPriorCount(int count);
+        int rssiPriorCount() const;
         
         GaussianProcessLDPLMultiModel& fillsUnknownBeaconRssi(bool fills);
         bool fillsUnknownBeaconRssi() const;
@@ -163,6 +255,22 @@ namespace loc{
         
         GaussianProcessLDPLMultiModel& coeffDiffFloorStdev(double);
         GaussianProcessLDPLMultiModel& tDelay(int);
+        GaussianProcessLDPLMultiModel& numThreads(int);
+        int numThreads() const;
+        // Worker threads shared with other models (e.g. the system model). This overrides numThreads.
+        GaussianProcessLDPLMultiModel& threadPool(ThreadPool::Ptr);
+        GaussianProcessLDPLMultiModel& numTrainingThreads(int);
+        int numTrainingThreads() const;
+        GaussianProcessLDPLMultiModel& trainingMemoryLimit(size_t);
+        size_t trainingMemoryLimit() const;
+        // compact-support GP prediction (<=0: exact)
+        GaussianProcessLDPLMultiModel& cutoffRadius(double);
+        
+        // Precompute predicted mean RSSI on grids covering beacons (+margin) on floors where beacons exist.
+        // States on the grids are evaluated by bilinear interpolation instead of the exact prediction.
+        GaussianProcessLDPLMultiModel& buildRssiRaster(double cellSize, double margin);
+        GaussianProcessLDPLMultiModel& clearRssiRaster();
+        bool usesRssiRaster() const;
         
         template<class Archive>
         void save(Archive& ar) const;
@@ -188,6 +296,19 @@ namespace loc{
             std::vector<double> vec{loc.x(), loc.y(), loc.z(), loc.floor()};
             return vec;
         }
+        
+        template<class Tlocation>
+        static Eigen::MatrixXd locationsToMat(const std::vector<Tlocation>& locs){
+            Eigen::MatrixXd X(locs.size(), 4);
+            for(int i=0; i<locs.size(); i++){
+                const Location& loc = locs.at(i);
+                X(i,0) = loc.x();
+                X(i,1) = loc.y();
+                X(i,2) = loc.z();
+                X(i,3) = loc.floor();
+            }
+            return X;
+        }
     };
     
     /**
@@ -212,10 +333,33 @@ namespace loc{
             matType = mt;
         }
         
+        // number of threads to train the model (<=0: hardware concurrency)
+        void setNumThreads(int nThreads){
+            numThreads = nThreads;
+        }
+        
+        // memory in bytes held at once by local models of GPLIGHT fitted in parallel (0: half of physical memory)
+        void setTrainingMemoryLimit(size_t memoryLimit){
+            trainingMemoryLimit = memoryLimit;
+        }
+        
+        // number and placement of inducing points for GPFITC
+        void setNumInducingPoints(int nInducingPoints){
+            numInducingPoints = nInducingPoints;
+        }
+        
+        void setInducingPointPlacement(GaussianProcessFITC::InducingPointPlacement placement){
+            inducingPointPlacement = placement;
+        }
+        
     private:
         std::shared_ptr<DataStore> mDataStore;
         GPType gpType = GPNORMAL;
         MatType matType = DENSE;
+        int numThreads = 0;
+        size_t trainingMemoryLimit = 0;
+        int numInducingPoints = 400;
+        GaussianProcessFITC::InducingPointPlacement inducingPointPlacement = GaussianProcessFITC::KMEANS;
     };
     
 }
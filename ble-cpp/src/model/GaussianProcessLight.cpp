@@ -21,9 +21,14 @@
  *******************************************************************************/
 
 #include <cfloat>
+#include <cmath>
+#include <algorithm>
 #include <random>
+#include <mutex>
+#include <condition_variable>
 
 #include "GaussianProcessLight.hpp"
+#include "ArrayUtils.hpp"
 
 void loc::GaussianProcessLight::CentroidBasedClusteringResult::printSummary() const {
     for (auto i=0; i < nCluster(); i++) {
@@ -59,47 +64,62 @@ loc::GaussianProcessLight::kMeansClustering(const Eigen::MatrixXd& X,
     std::vector<Eigen::VectorXd> lefts(X.rows());
     for (auto i=0; i < X.rows(); i++) { lefts.at(i) = X.row(i); }
     
+    // squared distance from each left sample to its nearest chosen center
+    std::vector<double> minDists(lefts.size(), DBL_MAX);
+    
+    //the distances to the last chosen center are updated in the same pass as the cumulative sums
+    //(a pass costs O(n), which is too small to run in parallel for every center)
     std::mt19937 mt;
+    std::vector<double> dists;
     for (size_t k=0; k < TARGET_N_CLUSTER; k++) {
-        std::deque<double> dists(1, 0.0);
-        for (auto x : lefts) {
-            double min_d = DBL_MAX;
-            for (auto c : centers) {
-                min_d = std::min(min_d, gaussianKernel_.sqsum(x.data(), c.data()));
+        dists.resize(lefts.size());
+        double sum = 0.0;
+        for (size_t i=0; i < lefts.size(); i++) {
+            if (!centers.empty()) {
+                minDists[i] = std::min(minDists[i], gaussianKernel_.sqsum(lefts[i].data(), centers.back().data()));
             }
-            dists.push_back(dists.back() + min_d);
+            sum += minDists[i];
+            dists[i] = sum;
         }
-        dists.pop_front();
-        assert(dists.size() == lefts.size());
         std::uniform_real_distribution<> rand(0.0, dists.back());
         const double oracle = rand(mt);
         const auto it_chosen = std::lower_bound(dists.begin(), dists.end(), oracle);
         const size_t idx_chosen = std::distance(dists.begin(), it_chosen);
         centers.push_back(lefts.at(idx_chosen));
         lefts.erase(lefts.begin() + idx_chosen);
+        minDists.erase(minDists.begin() + idx_chosen);
         assert(centers.size() + lefts.size() == X.rows());
     }
     assert(centers.size() == TARGET_N_CLUSTER);
     
     //k-means
     std::vector<std::vector<size_t>> labels(TARGET_N_CLUSTER);
+    std::vector<size_t> nearestClusters(X.rows());
+    std::vector<double> nearestSqDists(X.rows());
     const size_t MAX_ITERATION = 32;
     for (auto r=0; r < MAX_ITERATION; r++) {
         //clear previous labels
         for (auto i=0; i<labels.size(); i++) { labels.at(i).clear(); }
         
         //assign each sample to the nearest cluster
+        ArrayUtils::parallelFor(static_cast<int>(X.rows()), numThreads, [&](int i){
+            const Eigen::VectorXd x = X.row(i);
+            double min_d = DBL_MAX;
+            size_t iNearestCluster = 0;
+            for (size_t k=0; k < centers.size(); k++) {
+                const double d = gaussianKernel_.sqsum(x.data(), centers[k].data());
+                if (d < min_d) {
+                    min_d = d;
+                    iNearestCluster = k;
+                }
+            }
+            nearestClusters[i] = iNearestCluster;
+            nearestSqDists[i] = min_d;
+        });
         double sqdist_sum = 0.0;
         for (auto i=0; i < X.rows(); i++) {
-            std::vector<double> d;
-            for (auto c : centers) {
-                Eigen::VectorXd x = X.row(i);
-                d.push_back(gaussianKernel_.sqsum(x.data(), c.data()));
-            }
-            const auto it_nearest = std::min_element(d.begin(), d.end());
-            sqdist_sum += *it_nearest;
-            const size_t iNearestCluster = std::distance(d.begin(), it_nearest);
-            labels.at(iNearestCluster).push_back(i);
+            sqdist_sum += nearestSqDists[i];
+            labels.at(nearestClusters[i]).push_back(i);
         }
         std::cout << "sqdist_sum[" << r << "]= " << sqdist_sum << std::endl;
         for (auto l : labels) { std::cout << l.size() << ","; }
@@ -206,7 +226,9 @@ loc::GaussianProcessLight::improveWithOverlap(CentroidBasedClusteringResult& cr,
     std::vector<std::vector<Eigen::VectorXd>> Xbuf(n, empty);
     std::vector<std::vector<Eigen::VectorXd>> Ybuf(n, empty);
     
-    for (auto is=0; is < X.rows(); is++) {
+    //clusters which each sample is added to (the nearest first)
+    std::vector<std::vector<size_t>> memberships(X.rows());
+    ArrayUtils::parallelFor(static_cast<int>(X.rows()), numThreads, [&](int is){
         Eigen::VectorXd x = X.row(is);
         std::vector<double> weights(n);
         for (int i=0; i < n; ++i) {
@@ -214,14 +236,19 @@ loc::GaussianProcessLight::improveWithOverlap(CentroidBasedClusteringResult& cr,
         }
         std::vector<size_t> nearests = top_k(weights, std::min(k, n));
         
-        Xbuf.at(nearests[0]).push_back(X.row(is));
-        Ybuf.at(nearests[0]).push_back(Y.row(is));
+        auto& membership = memberships[is];
+        membership.push_back(nearests[0]);
         for (auto i=1; i < nearests.size(); i++) {
             if (weights[nearests[i]] > OVERLAP_SCALE * weights[nearests[0]]) {
-                Xbuf.at(nearests[i]).push_back(X.row(is));
-                Ybuf.at(nearests[i]).push_back(Y.row(is));
+                membership.push_back(nearests[i]);
             }
         }
+    });
+    for (auto is=0; is < X.rows(); is++) {
+        for (auto i : memberships[is]) {
+            Xbuf.at(i).push_back(X.row(is));
+            Ybuf.at(i).push_back(Y.row(is));
+        }
     }
     
     //remove empty rows
@@ -255,6 +282,216 @@ loc::GaussianProcessLight::improveWithOverlap(CentroidBasedClusteringResult& cr,
     }
 }
 
+std::vector<loc::GaussianProcess>
+loc::GaussianProcessLight::fitLocalModels(const CentroidBasedClusteringResult& cr) const
+{
+    const int n = static_cast<int>(cr.nCluster());
+    std::vector<GaussianProcess> lgps(n);
+    
+    const size_t memoryLimit = fitMemoryLimit!=0 ? fitMemoryLimit : ArrayUtils::physicalMemory()/2;
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t memoryInUse = 0;
+    auto release = [&](size_t memory) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            memoryInUse -= memory;
+        }
+        cv.notify_all();
+    };
+    
+    ArrayUtils::parallelFor(n, numThreads, [&](int k){
+        //kernel matrix, its Cholesky factor and a temporary of the same size dominate memory usage
+        const size_t nk = cr.XC[k].rows();
+        const size_t memory = 3 * nk * nk * sizeof(double);
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            //a single model is always allowed so that the pool never stalls
+            cv.wait(lock, [&]{ return memoryLimit==0 || memoryInUse==0 || memoryInUse + memory <= memoryLimit; });
+            memoryInUse += memory;
+        }
+        
+        GaussianProcess gp;
+        gp.setAsSparse(this->asSparse_);
+        gp.sigmaN(sigmaN_);
+        gp.gaussianKernel(gaussianKernel_);
+        try {
+            gp.fit(cr.XC[k], cr.YC[k]);
+        } catch (...) {
+            release(memory);
+            throw;
+        }
+        release(memory);
+        
+        lgps[k] = std::move(gp);
+    });
+    
+    return lgps;
+}
+
+void
+loc::GaussianProcessLight::nearestClusters(const double x[], std::vector<size_t>& neighbors, std::vector<double>& weights) const
+{
+    const size_t M = std::min<size_t>(mLocalsMixed_, centers_.size());
+    neighbors.clear();
+    weights.clear();
+    
+    const int* first = nullptr;
+    const int* last = nullptr;
+    if (clusterGrid_.findCandidates(x, M, first, last)) {
+        std::vector<double> candidateWeights(last - first);
+        for (size_t i=0; i < candidateWeights.size(); ++i) {
+            candidateWeights[i] = gaussianKernel_.computeKernel(x, centers_.at(first[i]).data());
+        }
+        for (auto i : top_k(candidateWeights, M)) {
+            neighbors.push_back(first[i]);
+            weights.push_back(candidateWeights[i]);
+        }
+    } else {
+        const size_t n = centers_.size();
+        std::vector<double> allWeights(n);
+        for (size_t i=0; i < n; ++i) {
+            allWeights[i] = gaussianKernel_.computeKernel(x, centers_.at(i).data());
+        }
+        for (auto i : top_k(allWeights, M)) {
+            neighbors.push_back(i);
+            weights.push_back(allWeights[i]);
+        }
+    }
+}
+
+void loc::GaussianProcessLight::ClusterLookupGrid::clear()
+{
+    nNeighbors_ = 0;
+    layers_.clear();
+    nx_ = 0;
+    ny_ = 0;
+    offsets_.clear();
+    candidates_.clear();
+}
+
+/**
+ * For each cell, a cluster is a candidate if its lower bound of the squared distance to the cell
+ * does not exceed the nNeighbors-th smallest upper bound among all clusters.
+ * Therefore the top-nNeighbors clusters of any input in the cell are contained in the candidates.
+ */
+void loc::GaussianProcessLight::ClusterLookupGrid::build(const std::vector<Eigen::VectorXd>& centers,
+                                                          const std::vector<std::pair<double, double>>& layers,
+                                                          const GaussianKernel& kernel,
+                                                          const size_t nNeighbors,
+                                                          const int nThreads)
+{
+    const double CELLS_PER_CENTER = 4.0;
+    const size_t MAX_N_LAYERS = 64;
+    const long MAX_N_CELLS = 1 << 22;
+    const double TOLERANCE = 1e-9;
+    
+    clear();
+    const size_t n = centers.size();
+    if (n <= nNeighbors) {
+        return; // all clusters are mixed anywhere
+    }
+    
+    if (layers.size() > MAX_N_LAYERS) {
+        std::cout << "cluster lookup grid is disabled: #layers=" << layers.size() << " > " << MAX_N_LAYERS << std::endl;
+        return;
+    }
+    layers_ = layers;
+    
+    double xmin = DBL_MAX, xmax = -DBL_MAX, ymin = DBL_MAX, ymax = -DBL_MAX;
+    for (const auto& c : centers) {
+        xmin = std::min(xmin, c(0));
+        xmax = std::max(xmax, c(0));
+        ymin = std::min(ymin, c(1));
+        ymax = std::max(ymax, c(1));
+    }
+    //inputs within about a center spacing from the centers are covered
+    const double spacing = std::sqrt(std::max(xmax - xmin, 1.0) * std::max(ymax - ymin, 1.0) / n);
+    cellSize_ = spacing / std::sqrt(CELLS_PER_CENTER);
+    x0_ = xmin - spacing;
+    y0_ = ymin - spacing;
+    nx_ = static_cast<long>(std::ceil((xmax - xmin + 2*spacing) / cellSize_));
+    ny_ = static_cast<long>(std::ceil((ymax - ymin + 2*spacing) / cellSize_));
+    const long nLayers = layers_.size();
+    if (nx_ * ny_ * nLayers > MAX_N_CELLS) {
+        std::cout << "cluster lookup grid is disabled: #cells=" << nx_ * ny_ * nLayers << " > " << MAX_N_CELLS << std::endl;
+        clear();
+        return;
+    }
+    nNeighbors_ = nNeighbors;
+    
+    const auto& lengthes = kernel.parameters().lengthes;
+    auto sq = [](double d) { return d*d; };
+    
+    const long nCells = nx_ * ny_ * nLayers;
+    std::vector<std::vector<int>> cellCandidates(nCells);
+    ArrayUtils::parallelFor(static_cast<int>(nCells), nThreads, [&](int cell){
+        const long ix = cell % nx_;
+        const long iy = (cell / nx_) % ny_;
+        const auto& layer = layers_.at(cell / (nx_ * ny_));
+        const double cx0 = x0_ + ix * cellSize_, cx1 = cx0 + cellSize_;
+        const double cy0 = y0_ + iy * cellSize_, cy1 = cy0 + cellSize_;
+        
+        std::vector<double> lower(n), upper(n);
+        for (size_t k=0; k < n; ++k) {
+            const auto& c = centers[k];
+            const double dLayer = sq((c(2) - layer.first)/lengthes[2]) + sq((c(3) - layer.second)/lengthes[3]);
+            const double dxMin = std::max(0.0, std::max(cx0 - c(0), c(0) - cx1));
+            const double dyMin = std::max(0.0, std::max(cy0 - c(1), c(1) - cy1));
+            const double dxMax = std::max(std::abs(c(0) - cx0), std::abs(c(0) - cx1));
+            const double dyMax = std::max(std::abs(c(1) - cy0), std::abs(c(1) - cy1));
+            lower[k] = sq(dxMin/lengthes[0]) + sq(dyMin/lengthes[1]) + dLayer;
+            upper[k] = sq(dxMax/lengthes[0]) + sq(dyMax/lengthes[1]) + dLayer;
+        }
+        std::vector<double> sortedUpper(upper);
+        std::nth_element(sortedUpper.begin(), sortedUpper.begin() + (nNeighbors - 1), sortedUpper.end());
+        const double threshold = sortedUpper[nNeighbors - 1];
+        
+        auto& candidates = cellCandidates[cell];
+        for (size_t k=0; k < n; ++k) {
+            if (lower[k] <= threshold + TOLERANCE * (1.0 + threshold)) {
+                candidates.push_back(static_cast<int>(k));
+            }
+        }
+    });
+    
+    offsets_.resize(nCells + 1);
+    offsets_[0] = 0;
+    for (long cell=0; cell < nCells; ++cell) {
+        offsets_[cell + 1] = offsets_[cell] + cellCandidates[cell].size();
+    }
+    candidates_.reserve(offsets_[nCells]);
+    for (const auto& candidates : cellCandidates) {
+        candidates_.insert(candidates_.end(), candidates.begin(), candidates.end());
+    }
+}
+
+bool loc::GaussianProcessLight::ClusterLookupGrid::findCandidates(const double x[],
+                                                                   const size_t nNeighbors,
+                                                                   const int*& first,
+                                                                   const int*& last) const
+{
+    if (empty() || nNeighbors != nNeighbors_) {
+        return false;
+    }
+    size_t l = 0;
+    while (l < layers_.size() && !(layers_[l].first == x[2] && layers_[l].second == x[3])) {
+        ++l;
+    }
+    if (l == layers_.size()) {
+        return false;
+    }
+    const double fx = std::floor((x[0] - x0_) / cellSize_);
+    const double fy = std::floor((x[1] - y0_) / cellSize_);
+    if (!(0 <= fx && fx < nx_ && 0 <= fy && fy < ny_)) {
+        return false;
+    }
+    const long cell = (l * ny_ + static_cast<long>(fy)) * nx_ + static_cast<long>(fx);
+    first = candidates_.data() + offsets_[cell];
+    last = candidates_.data() + offsets_[cell + 1];
+    return true;
+}
+
 //};
 ///**
 // * NO GOOD PERFORMANCE! Aggregative hierarchical clustering.
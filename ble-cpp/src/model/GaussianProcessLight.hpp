@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <limits>
+#include <set>
 #include <Eigen/Dense>
 
 #include "KernelFunction.hpp"
@@ -43,6 +44,33 @@ namespace loc{
         double sigmaN_ = 1.0;
         GaussianKernel gaussianKernel_;
         
+        /**
+         * Grid on the x-y plane which maps each cell to the clusters that can be mixed in prediction
+         * for any input in the cell. A grid is made for each (z, floor) of the training inputs.
+         */
+        class ClusterLookupGrid{
+        public:
+            void build(const std::vector<Eigen::VectorXd>& centers, const std::vector<std::pair<double, double>>& layers,
+                       const GaussianKernel& kernel, size_t nNeighbors, int nThreads);
+            void clear();
+            bool empty() const { return offsets_.size()==0; }
+            // Returns false if x is not covered by the grid. Otherwise [first, last) holds candidate cluster indices.
+            bool findCandidates(const double x[], size_t nNeighbors, const int*& first, const int*& last) const;
+        private:
+            size_t nNeighbors_ = 0;
+            std::vector<std::pair<double, double>> layers_; // (z, floor)
+            double x0_ = 0.0;
+            double y0_ = 0.0;
+            double cellSize_ = 0.0;
+            long nx_ = 0;
+            long ny_ = 0;
+            std::vector<long> offsets_;
+            std::vector<int> candidates_;
+        };
+        
+        // variables not to be serialized
+        ClusterLookupGrid clusterGrid_;
+        
     public:
         static const int N_FEATURES = 4;
         constexpr static const double MIN_DENOMINATOR = std::numeric_limits<double>::min() * 1e+16;
@@ -56,6 +84,10 @@ namespace loc{
         ClusteringType clType = KMEANS;
         bool usesOverlap = true;
         int mLocalsMixed_ = 3;
+        // number of threads used for clustering and local model fitting (<=0: hardware concurrency)
+        int numThreads = 0;
+        // upper bound of bytes allocated at once by local models being fitted in parallel (0: half of physical memory)
+        size_t fitMemoryLimit = 0;
         
         // A function for serealization
         template<class Archive>
@@ -132,20 +164,31 @@ namespace loc{
             centers_ = cr.centers;
             
             //Get local models by cluster
-            for (auto k=0; k < cr.nCluster(); k++) {
-                GaussianProcess gp;
-                gp.setAsSparse(this->asSparse_);
-                gp.sigmaN(sigmaN_);
-                gp.gaussianKernel(gaussianKernel_);
-                
-                gp.fit(cr.XC[k], cr.YC[k]);
-                
-                LGPs_.push_back(gp);
-            }
+            LGPs_ = fitLocalModels(cr);
+            
+            buildClusterLookupGrid();
             
             return *this;
         }
         
+        /**
+         * Precompute candidate clusters on a grid so that prediction does not scan all centers.
+         * This has to be called after deserialization. Prediction falls back to scanning all centers without the grid.
+         */
+        void buildClusterLookupGrid()
+        {
+            //inputs lie on the (z, floor) of the training samples while the centers are their means
+            std::set<std::pair<double, double>> layers;
+            for (const auto& lgp : LGPs_) {
+                const Eigen::MatrixXd X = lgp.X();
+                for (long i=0; i < X.rows(); i++) {
+                    layers.insert(std::make_pair(X(i,2), X(i,3)));
+                }
+            }
+            clusterGrid_.build(centers_, std::vector<std::pair<double, double>>(layers.begin(), layers.end()),
+                               gaussianKernel_, std::min<size_t>(mLocalsMixed_, centers_.size()), numThreads);
+        }
+        
         double predict(double x[], int index) const 
         {
             std::vector<int> indices(1, index);
@@ -156,23 +199,16 @@ namespace loc{
         //TODO change return type: Eigen::VectorXd would be better
         std::vector<double> predict(double x[], const std::vector<int>& indices) const
         {
-            const size_t M = mLocalsMixed_;
-            const size_t n = centers_.size();
-            
-            std::vector<double> weights(n);
-            for (size_t i=0; i < n; ++i) {
-                const double* c = centers_.at(i).data();
-                weights[i] = gaussianKernel_.computeKernel(x, c);
-            }
-            
             //indices of k-nearest (=top-k weight) neigbors
-            std::vector<size_t> neighbors = top_k(weights, std::min(M, n));
+            std::vector<size_t> neighbors;
+            std::vector<double> weights;
+            nearestClusters(x, neighbors, weights);
             
             Eigen::VectorXd sum_wy = Eigen::VectorXd::Zero(indices.size());
             double sum_w = 0.0;
-            for (auto m : neighbors) {
-                double w = weights.at(m);
-                std::vector<double> tmp = LGPs_.at(m).predict(x, indices);
+            for (size_t l=0; l < neighbors.size(); ++l) {
+                double w = weights.at(l);
+                std::vector<double> tmp = LGPs_.at(neighbors[l]).predict(x, indices);
                 Eigen::VectorXd y = Eigen::Map<Eigen::VectorXd>(tmp.data(), indices.size());
                 sum_wy += w * y;
                 sum_w  += w;
@@ -191,6 +227,72 @@ namespace loc{
             return ypreds;
         }
 
+        // Batch prediction. Rows of Xstar are grouped by local models so that each local model predicts at once.
+        Eigen::MatrixXd predict(const Eigen::MatrixXd& Xstar, const std::vector<int>& indices) const
+        {
+            const size_t n = centers_.size();
+            const long N = Xstar.rows();
+            const long m = indices.size();
+            
+            // neighbors of each row and rows assigned to each local model
+            std::vector<std::vector<size_t>> neighborsAll(N);
+            std::vector<std::vector<double>> weightsAll(N);
+            std::vector<std::vector<long>> positionsAll(N);
+            std::vector<std::vector<long>> rowsLocal(n);
+            for (long r=0; r < N; ++r) {
+                Eigen::VectorXd x = Xstar.row(r);
+                nearestClusters(x.data(), neighborsAll[r], weightsAll[r]);
+                for (auto k : neighborsAll[r]) {
+                    positionsAll[r].push_back(rowsLocal[k].size());
+                    rowsLocal[k].push_back(r);
+                }
+            }
+            
+            std::vector<Eigen::MatrixXd> Ylocals(n);
+            for (size_t k=0; k < n; ++k) {
+                const auto& rows = rowsLocal[k];
+                if (rows.size()==0) {
+                    continue;
+                }
+                Eigen::MatrixXd Xk(rows.size(), Xstar.cols());
+                for (size_t l=0; l < rows.size(); ++l) {
+                    Xk.row(l) = Xstar.row(rows[l]);
+                }
+                Ylocals[k] = LGPs_.at(k).predict(Xk, indices);
+            }
+            
+            Eigen::MatrixXd Ypred(N, m);
+            for (long r=0; r < N; ++r) {
+                const auto& neighbors = neighborsAll[r];
+                Eigen::RowVectorXd sum_wy = Eigen::RowVectorXd::Zero(m);
+                double sum_w = 0.0;
+                for (size_t l=0; l < neighbors.size(); ++l) {
+                    double w = weightsAll[r][l];
+                    sum_wy += w * Ylocals[neighbors[l]].row(positionsAll[r][l]);
+                    sum_w  += w;
+                }
+                if (sum_w > MIN_DENOMINATOR) {
+                    Ypred.row(r) = sum_wy / sum_w;
+                } else {
+                    Ypred.row(r) = Ylocals[neighbors.at(0)].row(positionsAll[r][0]);
+                }
+            }
+            return Ypred;
+        }
+
+        GaussianProcessLight& cutoffRadius(double cutoffRadius)
+        {
+            for (auto& lgp : LGPs_) {
+                lgp.cutoffRadius(cutoffRadius);
+            }
+            return *this;
+        }
+        
+        double cutoffRadius() const
+        {
+            return LGPs_.size()==0 ? 0.0 : LGPs_.at(0).cutoffRadius();
+        }
+        
         /**
          * Estimate parameters as preparation
          */
@@ -210,6 +312,52 @@ namespace loc{
             this->fit(X, Y);
         }
         
+        /*
+         * Append samples to the local model of the nearest center. Clusters are not updated.
+         */
+        GaussianProcessLight& append(const Eigen::MatrixXd& X, const Eigen::MatrixXd& Y, const Eigen::MatrixXd& Actives)
+        {
+            if(centers_.size()==0){
+                fitCV(X, Y, Actives);
+                return *this;
+            }
+            std::vector<std::vector<int>> clusterRows(centers_.size());
+            std::vector<double> x(X.cols());
+            for(long i=0; i<X.rows(); i++){
+                for(int j=0; j<X.cols(); j++){
+                    x[j] = X(i,j);
+                }
+                size_t nearest = 0;
+                double maxWeight = -1.0;
+                for(size_t k=0; k<centers_.size(); k++){
+                    double w = gaussianKernel_.computeKernel(x.data(), centers_.at(k).data());
+                    if(maxWeight < w){
+                        maxWeight = w;
+                        nearest = k;
+                    }
+                }
+                clusterRows.at(nearest).push_back(static_cast<int>(i));
+            }
+            for(size_t k=0; k<centers_.size(); k++){
+                const auto& rows = clusterRows.at(k);
+                if(rows.size()==0){
+                    continue;
+                }
+                Eigen::MatrixXd XC(rows.size(), X.cols());
+                Eigen::MatrixXd YC(rows.size(), Y.cols());
+                Eigen::MatrixXd ActivesC(rows.size(), Actives.cols());
+                for(int r=0; r<rows.size(); r++){
+                    XC.row(r) = X.row(rows[r]);
+                    YC.row(r) = Y.row(rows[r]);
+                    ActivesC.row(r) = Actives.row(rows[r]);
+                }
+                LGPs_.at(k).append(XC, YC, ActivesC);
+            }
+            //appended samples may lie on new (z, floor)
+            buildClusterLookupGrid();
+            return *this;
+        }
+        
 //        Eigen::VectorXd predictVarianceF(double x[]) const;
 //        Eigen::VectorXd predictVarianceF(const Eigen::VectorXd& kstar) const{;
 //        double computeLogLikelihood(double x[], const Eigen::VectorXd& y) const;
@@ -244,6 +392,17 @@ namespace loc{
                                 const Eigen::MatrixXd& X,
                                 const Eigen::MatrixXd& Y) const;
         
+        /**
+         * Find clusters of top-mLocalsMixed_ weights at x in descending order of weights.
+         */
+        void nearestClusters(const double x[], std::vector<size_t>& neighbors, std::vector<double>& weights) const;
+        
+        /**
+         * Fit a local model for each cluster by a pool of numThreads workers.
+         * A worker waits before fitting while the estimated memory of the models being fitted exceeds fitMemoryLimit.
+         */
+        std::vector<GaussianProcess> fitLocalModels(const CentroidBasedClusteringResult& cr) const;
+        
     public:
         // TODO move to an appropriate util class
         static std::vector<size_t> top_k(const std::vector<double>& values, const size_t k)
@@ -42,6 +42,10 @@ double GaussianKernel::variance() const{
     return variance_;
 }
 
+const GaussianKernel::Parameters& GaussianKernel::parameters() const{
+    return params;
+}
+
 double GaussianKernel::sqsum(const double x1[], const double x2[]) const {
     double sqsum = 0;
     for(int i=0; i<ndim; i++){
@@ -51,6 +55,18 @@ double GaussianKernel::sqsum(const double x1[], const double x2[]) const {
     return sqsum;
 }
 
+Eigen::MatrixXd GaussianKernel::computeKernelMatrix(const Eigen::MatrixXd& X1, const Eigen::MatrixXd& X2) const{
+    long n1 = X1.rows();
+    long n2 = X2.rows();
+    Eigen::ArrayXXd sqsum = Eigen::ArrayXXd::Zero(n1, n2);
+    for(int i=0; i<ndim; i++){
+        Eigen::ArrayXXd diff = (X1.col(i).array().replicate(1, n2) - X2.col(i).transpose().array().replicate(n1, 1))/params.lengthes[i];
+        sqsum += diff.square();
+    }
+    Eigen::MatrixXd K = (variance_ * (-sqsum).exp()).matrix();
+    return K;
+}
+
 template<class Archive>
 void GaussianKernel::Parameters::serialize(Archive& ar){
     ar(CEREAL_NVP(sigma_f));
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <iostream>
 #include <cmath>
+#include <Eigen/Core>
 
 
 class KernelFunction{
@@ -57,7 +58,10 @@ public:
     
     double computeKernel(const double x1[], const double x2[]) const override;
     double variance() const override;
+    const Parameters& parameters() const;
     double sqsum(const double x1[], const double x2[]) const;
+    // Kernel values between all rows of X1 and X2 (X1.rows() x X2.rows())
+    Eigen::MatrixXd computeKernelMatrix(const Eigen::MatrixXd& X1, const Eigen::MatrixXd& X2) const;
     
     template<class Archive>
     void save(Archive& ar) const;
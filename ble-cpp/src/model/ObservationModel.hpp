@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "Location.hpp"
+#include "State.hpp"
 
 namespace loc{
 
@@ -48,5 +49,13 @@ public:
 
 //template class ObservationModel<Location, Input>
 
+// Interface for observation models that evaluate particles stored in StatesSoA directly
+template<class Tinput> class ObservationModelSoA{
+public:
+    virtual ~ObservationModelSoA(){}
+    
+    virtual std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const StatesSoA & states, const Tinput& input) = 0;
+};
+
 }
 #endif /* ObservationModel_hpp */
@@ -62,17 +62,17 @@ namespace loc{
         
         // Perturb variables in State
         if(nSteps>0 || mProperty->doesUpdateWhenStopping() ){
-            state.orientationBias(state.orientationBias() + stateProperty->diffusionOrientationBias()*randomGenerator.nextGaussian()*dTime );
-            state.rssiBias(randomGenerator.nextTruncatedGaussian(state.rssiBias(),
-                                                                 stateProperty->diffusionRssiBias()*dTime,
-                                                                 stateProperty->minRssiBias(),
-                                                                 stateProperty->maxRssiBias()));
+            state.orientationBias(state.orientationBias() + stateProperty->diffusionOrientationBias()*noiseBlock.nextGaussian(randomGenerator)*dTime );
+            state.rssiBias(noiseBlock.nextTruncatedGaussian(randomGenerator, state.rssiBias(),
+                                                            stateProperty->diffusionRssiBias()*dTime,
+                                                            stateProperty->minRssiBias(),
+                                                            stateProperty->maxRssiBias()));
         }
         
         // Update orientation
         double previousOrientation = state.orientation();
         double orientationActual = yaw - state.orientationBias();
-        orientationActual += poseProperty->stdOrientation()*randomGenerator.nextGaussian()*dTime;
+        orientationActual += poseProperty->stdOrientation()*noiseBlock.nextGaussian(randomGenerator)*dTime;
         orientationActual = Pose::normalizeOrientaion(orientationActual);
         state.orientation(orientationActual);
         
@@ -85,10 +85,10 @@ namespace loc{
         double v = 0.0;
         double nV = state.normalVelocity();
         if(nSteps >0 || mProperty->doesUpdateWhenStopping()){
-            nV = randomGenerator.nextTruncatedGaussian(state.normalVelocity(),
-                                                          poseProperty->diffusionVelocity()*dTime,
-                                                          poseProperty->minVelocity(),
-                                                          poseProperty->maxVelocity());
+            nV = noiseBlock.nextTruncatedGaussian(randomGenerator, state.normalVelocity(),
+                                                  poseProperty->diffusionVelocity()*dTime,
+                                                  poseProperty->minVelocity(),
+                                                  poseProperty->maxVelocity());
             state.normalVelocity(nV);
         }
         
@@ -97,10 +97,10 @@ namespace loc{
             v = nV * velocityRate() * turningVelocityRate;
         }
         if(relativeVelocity()>0){
-            v += randomGenerator.nextTruncatedGaussian(relativeVelocity(),
-                                                 poseProperty->diffusionVelocity()*dTime,
-                                                 poseProperty->minVelocity(),
-                                                 poseProperty->maxVelocity());
+            v += noiseBlock.nextTruncatedGaussian(randomGenerator, relativeVelocity(),
+                                                  poseProperty->diffusionVelocity()*dTime,
+                                                  poseProperty->minVelocity(),
+                                                  poseProperty->maxVelocity());
         }
         state.velocity(v);
         
@@ -108,14 +108,33 @@ namespace loc{
         double x = state.x() + state.vx() * dTime;
         double y = state.y() + state.vy() * dTime;
         
-        State statePred(state);
-        statePred.x(x);
-        statePred.y(y);
+        state.x(x);
+        state.y(y);
         
-        return statePred;
+        return state;
     }
 
     
+    SystemModel<State, SystemModelInput>::Ptr PoseRandomWalker::cloneWithRandomStream(unsigned long seed, unsigned long stream) const{
+        auto model = std::make_shared<PoseRandomWalker>(*this);
+        model->randomGenerator.seed(seed, stream);
+        model->noiseBlock.clear();
+        return model;
+    }
+    
+    void PoseRandomWalker::seedRandomStream(unsigned long seed, unsigned long stream){
+        randomGenerator.seed(seed, stream);
+        noiseBlock.clear();
+    }
+    
+    void PoseRandomWalker::assignState(const SystemModel<State, SystemModelInput>& model){
+        RandomGenerator randGen = randomGenerator;
+        RandomNoiseBlock noise = std::move(noiseBlock);
+        *this = dynamic_cast<const PoseRandomWalker&>(model);
+        randomGenerator = randGen;
+        noiseBlock = std::move(noise);
+    }
+    
     double PoseRandomWalker::movingLevel(){
         if(isUnderControll){
             return mMovement;
@@ -78,6 +78,8 @@ namespace loc{
 
     protected:        
         RandomGenerator randomGenerator;
+        // per-particle noise drawn from randomGenerator in blocks
+        RandomNoiseBlock noiseBlock;
         PoseProperty::Ptr poseProperty = PoseProperty::Ptr(new PoseProperty);
         StateProperty::Ptr stateProperty = StateProperty::Ptr(new StateProperty);
         PoseRandomWalkerProperty::Ptr mProperty = PoseRandomWalkerProperty::Ptr(new PoseRandomWalkerProperty);
@@ -93,6 +95,9 @@ namespace loc{
         
         virtual std::vector<State> predict(std::vector<State> poses, SystemModelInput input) override;
         virtual State predict(State state, SystemModelInput input) override;
+        virtual SystemModel<State, SystemModelInput>::Ptr cloneWithRandomStream(unsigned long seed, unsigned long stream) const override;
+        virtual void seedRandomStream(unsigned long seed, unsigned long stream) override;
+        virtual void assignState(const SystemModel<State, SystemModelInput>& model) override;
         
         virtual double movingLevel();
     };
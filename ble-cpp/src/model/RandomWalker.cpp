@@ -45,8 +45,8 @@ namespace loc{
         double z = loc.z();
         double floor = loc.floor();
         
-        x += mRWProperty->sigma * mRandGen->nextGaussian();
-        y += mRWProperty->sigma * mRandGen->nextGaussian();
+        x += mRWProperty->sigma * mNoise.nextGaussian(*mRandGen);
+        y += mRWProperty->sigma * mNoise.nextGaussian(*mRandGen);
         
         State locNew;
         locNew.x(x).y(y).z(z).floor(floor);
@@ -56,15 +56,38 @@ namespace loc{
     template<class Ts, class Tin>
     std::vector<Ts> RandomWalker<Ts, Tin>::predict(std::vector<Ts> locations, Tin input){
         std::vector<Ts> locsNew;
+        locsNew.reserve(locations.size());
         this->startPredictions(locations, input);
-        for(Ts loc: locations){
-            Ts locNew = predict(loc, input);
-            locsNew.push_back(locNew);
+        for(const Ts& loc: locations){
+            locsNew.push_back(predict(loc, input));
         }
         this->endPredictions(locations, input);
         return locsNew;
     }
     
+    template<class Ts, class Tin>
+    typename SystemModel<Ts, Tin>::Ptr RandomWalker<Ts, Tin>::cloneWithRandomStream(unsigned long seed, unsigned long stream) const{
+        auto model = std::make_shared<RandomWalker<Ts, Tin>>(*this);
+        model->mRandGen = std::make_shared<RandomGenerator>(seed, stream);
+        model->mNoise.clear();
+        return model;
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalker<Ts, Tin>::seedRandomStream(unsigned long seed, unsigned long stream){
+        this->mRandGen->seed(seed, stream);
+        mNoise.clear();
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalker<Ts, Tin>::assignState(const SystemModel<Ts, Tin>& model){
+        auto randGen = this->mRandGen;
+        RandomNoiseBlock noise = std::move(mNoise);
+        *this = dynamic_cast<const RandomWalker<Ts, Tin>&>(model);
+        this->mRandGen = randGen;
+        mNoise = std::move(noise);
+    }
+    
     // Explicit instantiation
     template class RandomWalker<State, RandomWalkerInput>;
 }
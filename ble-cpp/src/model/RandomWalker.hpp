@@ -59,10 +59,15 @@ namespace loc{
         virtual RandomWalker<Ts, Tin>& setProperty(RandomWalkerProperty::Ptr property);
         virtual Ts predict(Ts state, Tin input) override;
         virtual std::vector<Ts> predict(std::vector<Ts> states, Tin input) override;
+        virtual typename SystemModel<Ts, Tin>::Ptr cloneWithRandomStream(unsigned long seed, unsigned long stream) const override;
+        virtual void seedRandomStream(unsigned long seed, unsigned long stream) override;
+        virtual void assignState(const SystemModel<Ts, Tin>& model) override;
         
     protected:
         RandomWalkerProperty::Ptr mRWProperty;
         std::shared_ptr<RandomGenerator> mRandGen;
+        // per-particle noise drawn from mRandGen in blocks
+        RandomNoiseBlock mNoise;
     };
     
 }
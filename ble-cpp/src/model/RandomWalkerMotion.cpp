@@ -28,6 +28,7 @@ namespace loc{
     template<class Ts, class Tin>
     Ts RandomWalkerMotion<Ts, Tin>::predict(Ts state, Tin input){
         auto& mRandGen = RandomWalker<Ts, Tin>::mRandGen;
+        auto& mNoise = RandomWalker<Ts, Tin>::mNoise;
         const auto& mPedometer = mRWMotionProperty->pedometer();
         const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
         
@@ -88,8 +89,8 @@ namespace loc{
             // Multyply sigma by turning velocity rate
             sigma = sigma * turningVelocityRate;
             
-            double nx = mRandGen->nextGaussian();
-            double ny = mRandGen->nextGaussian();
+            double nx = mNoise.nextGaussian(*mRandGen);
+            double ny = mNoise.nextGaussian(*mRandGen);
             double theta = std::atan2(ny, nx);
             
             double vx = sigma * nx;
@@ -129,6 +130,29 @@ namespace loc{
         }
     }
     
+    template<class Ts, class Tin>
+    typename SystemModel<Ts, Tin>::Ptr RandomWalkerMotion<Ts, Tin>::cloneWithRandomStream(unsigned long seed, unsigned long stream) const{
+        auto model = std::make_shared<RandomWalkerMotion<Ts, Tin>>(*this);
+        model->mRandGen = std::make_shared<RandomGenerator>(seed, stream);
+        model->mNoise.clear();
+        return model;
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::seedRandomStream(unsigned long seed, unsigned long stream){
+        this->mRandGen->seed(seed, stream);
+        this->mNoise.clear();
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::assignState(const SystemModel<Ts, Tin>& model){
+        auto randGen = this->mRandGen;
+        RandomNoiseBlock noise = std::move(this->mNoise);
+        *this = dynamic_cast<const RandomWalkerMotion<Ts, Tin>&>(model);
+        this->mRandGen = randGen;
+        this->mNoise = std::move(noise);
+    }
+    
     // Explicit instantiation
     template class RandomWalkerMotion<State, RandomWalkerInput>;
 }
@@ -86,6 +86,9 @@ namespace loc{
         
         virtual Ts predict(Ts state, Tin input) override;
         virtual RandomWalkerMotion& setProperty(RandomWalkerMotionProperty::Ptr);
+        virtual typename SystemModel<Ts, Tin>::Ptr cloneWithRandomStream(unsigned long seed, unsigned long stream) const override;
+        virtual void seedRandomStream(unsigned long seed, unsigned long stream) override;
+        virtual void assignState(const SystemModel<Ts, Tin>& model) override;
 
     protected:
         RandomWalkerMotionProperty::Ptr mRWMotionProperty;
@@ -28,6 +28,7 @@
 #include <memory>
 
 #include "Location.hpp"
+#include "State.hpp"
 
 namespace loc{
     
@@ -68,6 +69,13 @@ public:
         virtual std::vector<Ts> predict(std::vector<Ts> states, Tin input)  = 0;
         //virtual std::vector<Ts>* predict(std::vector<Ts> states) = 0;
         
+        // Updates states in place without allocating a new vector
+        virtual void predictInPlace(std::vector<Ts>& states, const Tin& input){
+            for(auto& state: states){
+                state = predict(std::move(state), input);
+            }
+        }
+        
         virtual void startPredictions(const std::vector<Ts>& states, const Tin& input){
             // Do nothing in a default method
         }
@@ -77,6 +85,20 @@ public:
         virtual void notifyObservationUpdated(){
             // Do nothing in a default method
         }
+        
+        // For parallel prediction.
+        // Returns a copy of this model that draws random numbers from the given stream (nullptr if not supported).
+        virtual Ptr cloneWithRandomStream(unsigned long seed, unsigned long stream) const{
+            return nullptr;
+        }
+        // Restarts the random stream of a copy returned by cloneWithRandomStream.
+        virtual void seedRandomStream(unsigned long seed, unsigned long stream){
+            // Do nothing in a default method
+        }
+        // Takes over the internal state except for the random generator from a copy used in parallel prediction.
+        virtual void assignState(const SystemModel<Ts, Tin>& model){
+            // Do nothing in a default method
+        }
     }; 
     /*
      template class SystemModel<Location, Input>;
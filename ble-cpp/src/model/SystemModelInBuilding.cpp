@@ -21,6 +21,7 @@
  *******************************************************************************/
 
 #include "SystemModelInBuilding.hpp"
+#include "ArrayUtils.hpp"
 
 namespace loc{
     
@@ -198,6 +199,7 @@ namespace loc{
     template<class Tstate, class Tinput>
     SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::systemModel(typename SystemModelT::Ptr sysModel){
         mSysModel = sysModel;
+        mWorkers.clear();
         return *this;
     }
     
@@ -211,18 +213,42 @@ namespace loc{
     template<class Tstate, class Tinput>
     SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::building(Building::Ptr building){
         mBuilding = building;
+        mWorkers.clear();
         return *this;
     }
     
     template<class Tstate, class Tinput>
     SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::property(SystemModelInBuildingProperty::Ptr property){
         mProperty = property;
+        mWorkers.clear();
         return *this;
     }
     
     template<class Tstate, class Tinput>
     SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::altitudeManager(AltitudeManager::Ptr altManager){
         mAltManager = altManager;
+        mWorkers.clear();
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::numThreads(int numThreads){
+        mNumThreads = numThreads;
+        mThreadPool.reset();
+        mWorkers.clear();
+        return *this;
+    }
+    
+    template<class Tstate, class Tinput>
+    int SystemModelInBuilding<Tstate, Tinput>::numThreads() const{
+        return mNumThreads;
+    }
+    
+    template<class Tstate, class Tinput>
+    SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::threadPool(ThreadPool::Ptr threadPool){
+        mThreadPool = threadPool;
+        mNumThreads = threadPool ? threadPool->numThreads() : 1;
+        mWorkers.clear();
         return *this;
     }
     
@@ -506,14 +532,78 @@ namespace loc{
     std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput>::predict(std::vector<Tstate> states, Tinput input){
         std::vector<Tstate> statesPredicted(states.size());
         mSysModel->startPredictions(states, input);
-        for(int i=0; i<states.size(); i++){
-            Tstate& st = states.at(i);
-            statesPredicted[i] = predict(st, input);
-        }
+        predictBlocks(states.size(), [&](SystemModelInBuilding& model, size_t i){
+            statesPredicted[i] = model.predict(states[i], input);
+        });
         mSysModel->endPredictions(states, input);
         return statesPredicted;
     }
     
+    template<class Tstate, class Tinput>
+    void SystemModelInBuilding<Tstate, Tinput>::predictInPlace(std::vector<Tstate>& states, const Tinput& input){
+        mSysModel->startPredictions(states, input);
+        predictBlocks(states.size(), [&](SystemModelInBuilding& model, size_t i){
+            auto& st = states[i];
+            // state history is not referenced in prediction
+            auto history = std::move(st.history);
+            st = model.predict(std::move(st), input);
+            st.history = std::move(history);
+        });
+        mSysModel->endPredictions(states, input);
+    }
+    
+    template<class Tstate, class Tinput>
+    void SystemModelInBuilding<Tstate, Tinput>::predictBlocks(size_t n, const std::function<void(SystemModelInBuilding&, size_t)>& predictAt){
+        int nWorkers = static_cast<int>(std::min(n, static_cast<size_t>(ArrayUtils::numThreads(mNumThreads))));
+        if(nWorkers<=1 || !prepareWorkers(nWorkers, mRandomGenerator.nextSeed())){
+            for(size_t i=0; i<n; i++){
+                predictAt(*this, i);
+            }
+            return;
+        }
+        if(!mThreadPool){
+            mThreadPool = std::make_shared<ThreadPool>(mNumThreads);
+        }
+        size_t blockSize = (n + nWorkers - 1)/nWorkers;
+        mThreadPool->parallelFor(nWorkers, [&](int t){
+            size_t end = std::min(n, (t+1)*blockSize);
+            for(size_t i=t*blockSize; i<end; i++){
+                predictAt(*mWorkers[t], i);
+            }
+        });
+        // Per-timestamp state (e.g. yaw tracking) is identical among the copies
+        mSysModel->assignState(*mWorkers.front()->mSysModel);
+    }
+    
+    template<class Tstate, class Tinput>
+    bool SystemModelInBuilding<Tstate, Tinput>::prepareWorkers(int nWorkers, unsigned long seed){
+        if(mWorkers.size()!=static_cast<size_t>(nWorkers)){
+            mWorkers.clear();
+            for(int t=0; t<nWorkers; t++){
+                auto sysModel = mSysModel->cloneWithRandomStream(seed, 2*t);
+                if(!sysModel){
+                    mWorkers.clear();
+                    return false;
+                }
+                auto worker = std::make_shared<SystemModelInBuilding>(*this);
+                worker->mSysModel = sysModel;
+                worker->mThreadPool.reset();
+                worker->mWorkers.clear();
+                worker->mRandomGenerator.seed(seed, 2*t+1);
+                mWorkers.push_back(worker);
+            }
+            return true;
+        }
+        // Take over the state of the system model updated in startPredictions and restart the random streams
+        for(int t=0; t<nWorkers; t++){
+            auto& worker = mWorkers[t];
+            worker->mSysModel->assignState(*mSysModel);
+            worker->mSysModel->seedRandomStream(seed, 2*t);
+            worker->mRandomGenerator.seed(seed, 2*t+1);
+        }
+        return true;
+    }
+    
     template<class Tstate, class Tinput>
     void SystemModelInBuilding<Tstate, Tinput>::notifyObservationUpdated(){
         mSysModel->notifyObservationUpdated();
@@ -24,11 +24,13 @@
 #define SystemModelInBuilding_hpp
 
 #include <stdio.h>
+#include <functional>
 #include "RandomWalker.hpp"
 #include "RandomWalkerMotion.hpp"
 #include "Building.hpp"
 #include "AltitudeManager.hpp"
 #include "SerializeUtils.hpp"
+#include "ArrayUtils.hpp"
 
 namespace loc{
     
@@ -159,6 +161,16 @@ namespace loc{
         Building::Ptr mBuilding;
         SystemModelInBuildingProperty::Ptr mProperty;
         AltitudeManager::Ptr mAltManager;
+        int mNumThreads = 1;
+        ThreadPool::Ptr mThreadPool;
+        // Copies of this model used by the workers. They are kept across predictions and only reseeded.
+        std::vector<std::shared_ptr<SystemModelInBuilding>> mWorkers;
+        
+        // Calls predictAt(model, i) for i in [0, n). Particles are split into contiguous blocks,
+        // each of which is predicted by a copy of this model with its own random stream.
+        void predictBlocks(size_t n, const std::function<void(SystemModelInBuilding&, size_t)>& predictAt);
+        // Prepares nWorkers copies drawing from streams of seed. Returns false if the system model cannot be copied.
+        bool prepareWorkers(int nWorkers, unsigned long seed);
         
         Tstate moveOnElevator(const Tstate& state, Tinput input);
         Tstate moveOnStair(const Tstate& state, Tinput input);
@@ -178,9 +190,15 @@ namespace loc{
         SystemModelInBuilding& building(Building::Ptr building);
         SystemModelInBuilding& property(SystemModelInBuildingProperty::Ptr property);
         SystemModelInBuilding& altitudeManager(AltitudeManager::Ptr altManager);
+        // Number of workers in prediction (<=0: hardware concurrency). Results are reproducible for a fixed number of workers.
+        SystemModelInBuilding& numThreads(int numThreads);
+        int numThreads() const;
+        // Worker threads shared with other models (e.g. the observation model). This overrides numThreads.
+        SystemModelInBuilding& threadPool(ThreadPool::Ptr threadPool);
         
         Tstate predict(Tstate state, Tinput input) override;
         std::vector<Tstate> predict(std::vector<Tstate> states, Tinput input) override;
+        void predictInPlace(std::vector<Tstate>& states, const Tinput& input) override;
         
         virtual void notifyObservationUpdated() override;
         
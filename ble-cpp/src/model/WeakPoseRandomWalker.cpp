@@ -27,6 +27,7 @@ namespace loc{
     template<class Ts, class Tin>
     Ts WeakPoseRandomWalker<Ts, Tin>::predict(Ts state, Tin input){
         auto& mRandGen = RandomWalker<Ts, Tin>::mRandGen;
+        auto& mNoise = RandomWalker<Ts, Tin>::mNoise;
         auto& mRWMotionProperty = RandomWalkerMotion<Ts,Tin>::mRWMotionProperty;
         const auto& mPedometer = mRWMotionProperty->pedometer();
         const auto& mOrientationMeter = mRWMotionProperty->orientationMeter();
@@ -95,26 +96,26 @@ namespace loc{
                     double sqdt_long = std::sqrt(dt_long);
                     // Perturb variables in State (orientationBias, rssiBias)
                     double oriTmp;
-                    if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationBiasJump()){
-                        oriTmp = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble()-0.5));
+                    if( mNoise.nextDouble(*mRandGen) < wPRWProperty->probabilityOrientationBiasJump()){
+                        oriTmp = Pose::normalizeOrientaion( 2.0 * M_PI * (mNoise.nextDouble(*mRandGen)-0.5));
                     }else{
-                        oriTmp = mRandGen->nextWrappedNormal(state.orientationBias(),
-                                                             mStateProperty->diffusionOrientationBias() * sqdt_long );
+                        oriTmp = mNoise.nextWrappedNormal(*mRandGen, state.orientationBias(),
+                                                          mStateProperty->diffusionOrientationBias() * sqdt_long );
                     }
                     state.orientationBias(oriTmp);
-                    state.rssiBias(mRandGen->nextTruncatedGaussian(state.rssiBias(), mStateProperty->diffusionRssiBias() * sqdt_long , mStateProperty->minRssiBias(), mStateProperty->maxRssiBias()));
+                    state.rssiBias(mNoise.nextTruncatedGaussian(*mRandGen, state.rssiBias(), mStateProperty->diffusionRssiBias() * sqdt_long , mStateProperty->minRssiBias(), mStateProperty->maxRssiBias()));
                     
                     // Perturb variables in Pose (normal velocity)
                     double nV = state.normalVelocity();
-                    nV = mRandGen->nextTruncatedGaussian(state.normalVelocity(),
-                                                         mPoseProperty->diffusionVelocity() * sqdt_long,
-                                                         mPoseProperty->minVelocity(),
-                                                         mPoseProperty->maxVelocity());
+                    nV = mNoise.nextTruncatedGaussian(*mRandGen, state.normalVelocity(),
+                                                      mPoseProperty->diffusionVelocity() * sqdt_long,
+                                                      mPoseProperty->minVelocity(),
+                                                      mPoseProperty->maxVelocity());
                     state.normalVelocity(nV);
                     
                     // Assign orientationAlignment
                     state.orientationAlignment(0.0);
-                    if( mRandGen->nextDouble() < wPRWProperty->probabilityBackwardMove()){
+                    if( mNoise.nextDouble(*mRandGen) < wPRWProperty->probabilityBackwardMove()){
                         double oriBW = M_PI;
                         state.orientationAlignment(oriBW);
                     }
@@ -125,9 +126,9 @@ namespace loc{
             double orientationActual = yaw - state.orientationBias();
             if(movLevel>0 ){
                 // Add noise to orientation
-                orientationActual = mRandGen->nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdt);
-                if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationJump() ){
-                    orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble() - 0.5));
+                orientationActual = mNoise.nextWrappedNormal(*mRandGen, orientationActual, mPoseProperty->stdOrientation() * sqdt);
+                if( mNoise.nextDouble(*mRandGen) < wPRWProperty->probabilityOrientationJump() ){
+                    orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (mNoise.nextDouble(*mRandGen) - 0.5));
                 }
             }
             state.orientation(orientationActual);
@@ -139,10 +140,10 @@ namespace loc{
                 v = nV * velocityRate() * turningVelocityRate;
             }
             if(relativeVelocity() > 0){
-                v += mRandGen->nextTruncatedGaussian(relativeVelocity(),
-                                                     mPoseProperty->diffusionVelocity()*sqdt,
-                                                     mPoseProperty->minVelocity(),
-                                                     mPoseProperty->maxVelocity());
+                v += mNoise.nextTruncatedGaussian(*mRandGen, relativeVelocity(),
+                                                  mPoseProperty->diffusionVelocity()*sqdt,
+                                                  mPoseProperty->minVelocity(),
+                                                  mPoseProperty->maxVelocity());
             }
             state.velocity(v);
             
@@ -153,19 +154,18 @@ namespace loc{
             double dx_v = state.velocity()*std::cos(oriActAl) * dt;
             double dy_v = state.velocity()*std::sin(oriActAl) * dt;
             
-            double dx_noise = sigma * mRandGen->nextGaussian() * sqdt;
-            double dy_noise = sigma * mRandGen->nextGaussian() * sqdt;
+            double dx_noise = sigma * mNoise.nextGaussian(*mRandGen) * sqdt;
+            double dy_noise = sigma * mNoise.nextGaussian(*mRandGen) * sqdt;
             
             double poseRwr = wPRWProperty->poseRandomWalkRate();
             double rwr = wPRWProperty->randomWalkRate();
             double x = state.x() + poseRwr * dx_v + rwr * dx_noise;
             double y = state.y() + poseRwr * dy_v + rwr * dy_noise;
             
-            State statePred(state);
-            statePred.x(x);
-            statePred.y(y);
+            state.x(x);
+            state.y(y);
             
-            return statePred;
+            return state;
         }else{
             if(!mPedometer){
                 BOOST_THROW_EXCEPTION(LocException("Pedometer is not set to WeakPoseRandomWalker."));
@@ -199,6 +199,29 @@ namespace loc{
         wasFiltered = true;
     }
     
+    template<class Ts, class Tin>
+    typename SystemModel<Ts, Tin>::Ptr WeakPoseRandomWalker<Ts, Tin>::cloneWithRandomStream(unsigned long seed, unsigned long stream) const{
+        auto model = std::make_shared<WeakPoseRandomWalker<Ts, Tin>>(*this);
+        model->mRandGen = std::make_shared<RandomGenerator>(seed, stream);
+        model->mNoise.clear();
+        return model;
+    }
+    
+    template<class Ts, class Tin>
+    void WeakPoseRandomWalker<Ts, Tin>::seedRandomStream(unsigned long seed, unsigned long stream){
+        this->mRandGen->seed(seed, stream);
+        this->mNoise.clear();
+    }
+    
+    template<class Ts, class Tin>
+    void WeakPoseRandomWalker<Ts, Tin>::assignState(const SystemModel<Ts, Tin>& model){
+        auto randGen = this->mRandGen;
+        RandomNoiseBlock noise = std::move(this->mNoise);
+        *this = dynamic_cast<const WeakPoseRandomWalker<Ts, Tin>&>(model);
+        this->mRandGen = randGen;
+        this->mNoise = std::move(noise);
+    }
+    
     template class WeakPoseRandomWalker<State, SystemModelInput>;
     
 }
@@ -127,6 +127,9 @@ namespace loc {
         virtual void startPredictions(const std::vector<Ts>& states, const Tin&) override;
         virtual void endPredictions(const std::vector<Ts>& states, const Tin&) override;
         virtual void notifyObservationUpdated() override;
+        virtual typename SystemModel<Ts, Tin>::Ptr cloneWithRandomStream(unsigned long seed, unsigned long stream) const override;
+        virtual void seedRandomStream(unsigned long seed, unsigned long stream) override;
+        virtual void assignState(const SystemModel<Ts, Tin>& model) override;
         
         virtual void setWeakPoseRandomWalkerProperty(WeakPoseRandomWalkerProperty::Ptr wPRWProperty){
             this->wPRWProperty = wPRWProperty;
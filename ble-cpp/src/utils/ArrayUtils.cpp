@@ -23,6 +23,10 @@
 #include "ArrayUtils.hpp"
 #include "LocException.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
 void ArrayUtils::normalize(double outArray[], const double inArray[], int n){
     double sum = 0;
     for(int i=0; i<n; i++){
@@ -71,3 +75,126 @@ std::vector<double> ArrayUtils::eigenVectorToEigen(Eigen::VectorXd V){
     Eigen::Map<Eigen::VectorXd>(&v[0], n, 1 ) = V;
     return v;
 }
+
+// Returns the number of worker threads to be used. nThreads<=0 means the number of hardware threads.
+int ArrayUtils::numThreads(int nThreads){
+    if(0<nThreads){
+        return nThreads;
+    }
+    int nHardware = (int) std::thread::hardware_concurrency();
+    return 0<nHardware ? nHardware : 1;
+}
+
+size_t ArrayUtils::physicalMemory(){
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGE_SIZE)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if(0<pages && 0<pageSize){
+        return static_cast<size_t>(pages)*static_cast<size_t>(pageSize);
+    }
+#endif
+    return 0;
+}
+
+int ArrayUtils::numThreadsForMemory(int nThreads, size_t memoryPerThread, size_t memoryLimit){
+    nThreads = numThreads(nThreads);
+    if(memoryLimit==0){
+        memoryLimit = physicalMemory()/2;
+    }
+    if(memoryLimit==0 || memoryPerThread==0){
+        return nThreads;
+    }
+    size_t nFit = memoryLimit/memoryPerThread;
+    return static_cast<int>(std::max<size_t>(1, std::min<size_t>(nThreads, nFit)));
+}
+
+ThreadPool::ThreadPool(int nThreads) : mNumThreads(ArrayUtils::numThreads(nThreads)), mErrors(mNumThreads){
+    for(int t=1; t<mNumThreads; t++){
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mStarted.notify_all();
+    for(auto& worker: mWorkers){
+        worker.join();
+    }
+}
+
+int ThreadPool::numThreads() const{
+    return mNumThreads;
+}
+
+// Nesting depth of parallelFor tasks on the current thread
+static thread_local int threadPoolTaskDepth = 0;
+
+void ThreadPool::runBlock(int t){
+    int begin = t*mBlockSize;
+    int end = std::min(mN, begin + mBlockSize);
+    threadPoolTaskDepth++;
+    try{
+        if(begin<end){
+            (*mTask)(begin, end);
+        }
+    }catch(...){
+        mErrors[t] = std::current_exception();
+    }
+    threadPoolTaskDepth--;
+}
+
+void ThreadPool::runBlocks(int n, const std::function<void(int, int)>& task){
+    if(n<=0){
+        return;
+    }
+    if(mNumThreads<=1 || n==1 || 0<threadPoolTaskDepth){
+        task(0, n);
+        return;
+    }
+    std::lock_guard<std::mutex> runLock(mRunMutex);
+    int nBlocks = std::min(mNumThreads, n);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mN = n;
+        mBlockSize = (n + nBlocks - 1)/nBlocks;
+        std::fill(mErrors.begin(), mErrors.end(), nullptr);
+        mPending = mNumThreads - 1;
+        mGeneration++;
+    }
+    mStarted.notify_all();
+    runBlock(0);
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mFinished.wait(lock, [this]{ return mPending==0; });
+        mTask = nullptr;
+    }
+    for(auto& error: mErrors){
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void ThreadPool::workerLoop(int t){
+    unsigned long generation = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStarted.wait(lock, [&]{ return mStopping || mGeneration!=generation; });
+            if(mStopping){
+                return;
+            }
+            generation = mGeneration;
+        }
+        runBlock(t);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPending--;
+        }
+        mFinished.notify_one();
+    }
+}
@@ -28,6 +28,12 @@
 #include <algorithm>
 #include <vector>
 #include <cmath>
+#include <thread>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 #include <Eigen/Core>
 
@@ -41,6 +47,97 @@ public:
     
     static Eigen::VectorXd vectorToEigenVector(std::vector<double>);
     static std::vector<double> eigenVectorToEigen(Eigen::VectorXd);
+    
+    static int numThreads(int nThreads);
+    // Physical memory in bytes (0 if unknown)
+    static size_t physicalMemory();
+    // numThreads(nThreads) bounded so that threads each holding memoryPerThread bytes fit in memoryLimit
+    // (memoryLimit=0: half of physical memory). At least one thread is returned.
+    static int numThreadsForMemory(int nThreads, size_t memoryPerThread, size_t memoryLimit);
+    
+    // Calls func(i) for i in [0, n) by splitting the range into contiguous blocks processed by worker threads.
+    // func must only write to outputs indexed by i so that results do not depend on the number of threads.
+    template<class Function>
+    static void parallelFor(int n, int nThreads, Function func){
+        nThreads = std::min(numThreads(nThreads), n);
+        if(nThreads<=1){
+            for(int i=0; i<n; i++){
+                func(i);
+            }
+            return;
+        }
+        int blockSize = (n + nThreads - 1)/nThreads;
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(nThreads);
+        for(int t=0; t<nThreads; t++){
+            int begin = t*blockSize;
+            int end = std::min(n, begin + blockSize);
+            workers.emplace_back([&func, &errors, t, begin, end](){
+                try{
+                    for(int i=begin; i<end; i++){
+                        func(i);
+                    }
+                }catch(...){
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for(auto& worker: workers){
+            worker.join();
+        }
+        for(auto& error: errors){
+            if(error){
+                std::rethrow_exception(error);
+            }
+        }
+    }
+};
+
+/**
+ Persistent worker threads for loops run on every filter step (prediction, likelihood evaluation).
+ parallelFor splits [0, n) into the same contiguous blocks as ArrayUtils::parallelFor
+ but does not create threads per call. A call made inside a parallelFor task runs serially.
+ **/
+class ThreadPool{
+    
+public:
+    using Ptr = std::shared_ptr<ThreadPool>;
+    
+    // nThreads<=0: hardware concurrency. The calling thread processes the first block.
+    explicit ThreadPool(int nThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    int numThreads() const;
+    
+    template<class Function>
+    void parallelFor(int n, Function func){
+        runBlocks(n, [&func](int begin, int end){
+            for(int i=begin; i<end; i++){
+                func(i);
+            }
+        });
+    }
+    
+private:
+    int mNumThreads;
+    std::vector<std::thread> mWorkers;
+    std::mutex mRunMutex; // serializes parallelFor calls from different threads
+    std::mutex mMutex;
+    std::condition_variable mStarted;
+    std::condition_variable mFinished;
+    unsigned long mGeneration = 0;
+    int mPending = 0;
+    bool mStopping = false;
+    const std::function<void(int, int)>* mTask = nullptr;
+    int mN = 0;
+    int mBlockSize = 0;
+    std::vector<std::exception_ptr> mErrors;
+    
+    void runBlocks(int n, const std::function<void(int, int)>& task);
+    void runBlock(int t);
+    void workerLoop(int t);
 };
 
 #endif /* ArrayUtils_hpp */
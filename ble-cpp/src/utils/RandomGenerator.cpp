@@ -21,27 +21,162 @@
  *******************************************************************************/
 
 #include <iostream>
+#include <cmath>
 #include "RandomGenerator.hpp"
 #include "LocException.hpp"
 #include "MathUtils.hpp"
 #include "sstream"
+#include <boost/math/special_functions/erf.hpp>
 
 namespace loc{
     
+    namespace{
+        const std::uint32_t kPhiloxM0 = 0xD2511F53u;
+        const std::uint32_t kPhiloxM1 = 0xCD9E8D57u;
+        const std::uint32_t kPhiloxW0 = 0x9E3779B9u;
+        const std::uint32_t kPhiloxW1 = 0xBB67AE85u;
+        const int kPhiloxRounds = 10;
+        
+        // Philox4x32-10 for N consecutive blocks.
+        // Lanes are processed in inner loops without branches so that compilers can vectorize the rounds.
+        template<int N>
+        inline void philoxBlocks(std::uint64_t firstBlock, const std::uint32_t key[2], const std::uint32_t stream[2], std::uint32_t out[4][N]){
+            std::uint32_t c0[N], c1[N], c2[N], c3[N];
+            for(int j=0; j<N; j++){
+                std::uint64_t block = firstBlock + j;
+                c0[j] = static_cast<std::uint32_t>(block);
+                c1[j] = static_cast<std::uint32_t>(block >> 32);
+                c2[j] = stream[0];
+                c3[j] = stream[1];
+            }
+            std::uint32_t k0 = key[0];
+            std::uint32_t k1 = key[1];
+            for(int r=0; r<kPhiloxRounds; r++){
+                for(int j=0; j<N; j++){
+                    std::uint64_t p0 = static_cast<std::uint64_t>(kPhiloxM0) * c0[j];
+                    std::uint64_t p1 = static_cast<std::uint64_t>(kPhiloxM1) * c2[j];
+                    std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[j] ^ k0;
+                    std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[j] ^ k1;
+                    c1[j] = static_cast<std::uint32_t>(p1);
+                    c3[j] = static_cast<std::uint32_t>(p0);
+                    c0[j] = n0;
+                    c2[j] = n2;
+                }
+                k0 += kPhiloxW0;
+                k1 += kPhiloxW1;
+            }
+            for(int j=0; j<N; j++){
+                out[0][j] = c0[j];
+                out[1][j] = c1[j];
+                out[2][j] = c2[j];
+                out[3][j] = c3[j];
+            }
+        }
+        
+        // Uniform double in [0, 1) from 53 bits of two words
+        inline double toUnitDouble(std::uint32_t hi, std::uint32_t lo){
+            return ((static_cast<std::uint64_t>(hi) << 32 | lo) >> 11) * (1.0/9007199254740992.0);
+        }
+    }
+    
+    Philox4x32::Philox4x32(std::uint64_t key, std::uint64_t stream){
+        seed(key, stream);
+    }
+    
+    void Philox4x32::seed(std::uint64_t key, std::uint64_t stream){
+        key_[0] = static_cast<std::uint32_t>(key);
+        key_[1] = static_cast<std::uint32_t>(key >> 32);
+        stream_[0] = static_cast<std::uint32_t>(stream);
+        stream_[1] = static_cast<std::uint32_t>(stream >> 32);
+        block_ = 0;
+        position_ = 4;
+    }
+    
+    void Philox4x32::discard(unsigned long long n){
+        unsigned long long remaining = 4 - position_;
+        if(n <= remaining){
+            position_ += static_cast<int>(n);
+            return;
+        }
+        n -= remaining;
+        block_ += n/4;
+        position_ = 4;
+        int r = static_cast<int>(n%4);
+        if(0 < r){
+            generate(block_++, buffer_);
+            position_ = r;
+        }
+    }
+    
+    std::uint64_t Philox4x32::reserveBlocks(std::uint64_t nBlocks){
+        position_ = 4;
+        std::uint64_t first = block_;
+        block_ += nBlocks;
+        return first;
+    }
+    
+    void Philox4x32::generate(std::uint64_t blockIndex, std::uint32_t out[4]) const{
+        std::uint32_t words[4][1];
+        philoxBlocks<1>(blockIndex, key_, stream_, words);
+        for(int i=0; i<4; i++){
+            out[i] = words[i][0];
+        }
+    }
+    
+    constexpr int Philox4x32::lanes;
+    
+    void Philox4x32::generateLanes(std::uint64_t firstBlock, std::uint32_t out[4][lanes]) const{
+        philoxBlocks<lanes>(firstBlock, key_, stream_, out);
+    }
+    
+    RandomGenerator::RandomGenerator(unsigned long seed, unsigned long stream){
+        this->seed(seed, stream);
+    }
+    
+    void RandomGenerator::seed(unsigned long seed, unsigned long stream){
+        engine.seed(seed, stream);
+        hasSpareGaussian = false;
+    }
+    
+    void RandomGenerator::discard(unsigned long long n){
+        engine.discard(2*n);
+    }
+    
+    unsigned long RandomGenerator::nextSeed(){
+        std::uint64_t hi = engine();
+        std::uint64_t lo = engine();
+        return static_cast<unsigned long>(hi << 32 | lo);
+    }
+    
     int RandomGenerator::nextInt(int n){
         std::uniform_int_distribution<> uniIntDist(0,n);
         return uniIntDist(engine);
     }
     
     double RandomGenerator::nextDouble(){
-        return uniformDistribution(engine);
+        std::uint32_t hi = engine();
+        std::uint32_t lo = engine();
+        return toUnitDouble(hi, lo);
     }
     
     double RandomGenerator::nextGaussian(){
-        return normalDistribution(engine);
+        // Box-Muller transform
+        if(hasSpareGaussian){
+            hasSpareGaussian = false;
+            return spareGaussian;
+        }
+        double r = std::sqrt(-2.0*std::log(1.0 - nextDouble()));
+        double theta = 2.0*M_PI*nextDouble();
+        spareGaussian = r*std::sin(theta);
+        hasSpareGaussian = true;
+        return r*std::cos(theta);
     }
     
     double RandomGenerator::nextTruncatedGaussian(double mean, double std, double min, double max){
+        return truncatedGaussian(nextDouble(), mean, std, min, max);
+    }
+    
+    double RandomGenerator::truncatedGaussian(double u, double mean, double std, double min, double max){
         if(mean < min){
             std::stringstream ss;
             ss << "mean < min (" << "mean=" << mean << ", min=" << min << ", max=" << ")";
@@ -52,14 +187,33 @@ namespace loc{
             ss << "max < mean (" << "mean=" << mean << ", min=" << min << ", max=" << ")";
             BOOST_THROW_EXCEPTION(LocException(ss.str()));
         }
-        double value = mean;
-        for(int i=0;i<max_iteration; i++){
-            value = mean + std*nextGaussian();
-            if(min<=value && value<=max){
-                break;
-            }
+        if(std<=0 || max<=min){
+            return mean;
+        }
+        // Standardized bounds. The tail farther from the mean is sampled through the survival function
+        // Q(z) = erfc(z/sqrt(2))/2 so that the precision is kept for bounds far from the mean.
+        double a = (min - mean)/std;
+        double b = (max - mean)/std;
+        double sign = 1.0;
+        if(a + b < 0){
+            std::swap(a, b);
+            a = -a;
+            b = -b;
+            sign = -1.0;
         }
-        return value;
+        double Qa = 0.5*std::erfc(a/M_SQRT2);
+        double Qb = 0.5*std::erfc(b/M_SQRT2);
+        double q = Qa - u*(Qa - Qb);
+        double z;
+        if(q <= 0){
+            z = b;
+        }else if(1 <= q){
+            z = a;
+        }else{
+            z = M_SQRT2*boost::math::erfc_inv(2.0*q);
+            z = std::min(b, std::max(a, z));
+        }
+        return mean + sign*std*z;
     }
     
     double RandomGenerator::nextWrappedNormal(double mean, double std){
@@ -89,4 +243,86 @@ namespace loc{
         }
         return intSet;
     }
+    
+    void RandomGenerator::fillDoubles(double values[], size_t n){
+        const int lanes = Philox4x32::lanes;
+        size_t nBlocks = (n+1)/2;
+        std::uint64_t first = engine.reserveBlocks(nBlocks);
+        std::uint32_t words[4][lanes];
+        for(size_t b=0; b<nBlocks; b+=lanes){
+            engine.generateLanes(first + b, words);
+            size_t offset = 2*b;
+            if(offset + 2*lanes <= n){
+                for(int j=0; j<lanes; j++){
+                    values[offset + 2*j] = toUnitDouble(words[0][j], words[1][j]);
+                    values[offset + 2*j + 1] = toUnitDouble(words[2][j], words[3][j]);
+                }
+            }else{
+                for(int j=0; offset + 2*j < n; j++){
+                    values[offset + 2*j] = toUnitDouble(words[0][j], words[1][j]);
+                    if(offset + 2*j + 1 < n){
+                        values[offset + 2*j + 1] = toUnitDouble(words[2][j], words[3][j]);
+                    }
+                }
+            }
+        }
+    }
+    
+    void RandomGenerator::fillGaussians(double values[], size_t n){
+        // Box-Muller transform applied to pairs of uniforms
+        size_t nPairs = n/2;
+        fillDoubles(values, 2*nPairs);
+        for(size_t i=0; i<nPairs; i++){
+            double r = std::sqrt(-2.0*std::log(1.0 - values[2*i]));
+            double theta = 2.0*M_PI*values[2*i+1];
+            values[2*i] = r*std::cos(theta);
+            values[2*i+1] = r*std::sin(theta);
+        }
+        if(n%2 == 1){
+            values[n-1] = nextGaussian();
+        }
+    }
+    
+    void RandomGenerator::fillTruncatedGaussians(double values[], const double means[], double std, double min, double max, size_t n){
+        fillDoubles(values, n);
+        for(size_t i=0; i<n; i++){
+            values[i] = truncatedGaussian(values[i], means[i], std, min, max);
+        }
+    }
+    
+    RandomNoiseBlock::RandomNoiseBlock(size_t blockSize) : blockSize_(std::max(blockSize, static_cast<size_t>(1))){
+    }
+    
+    void RandomNoiseBlock::clear(){
+        doubles_.clear();
+        gaussians_.clear();
+        nextDouble_ = 0;
+        nextGaussian_ = 0;
+    }
+    
+    double RandomNoiseBlock::nextDouble(RandomGenerator& randGen){
+        if(doubles_.size() <= nextDouble_){
+            doubles_.resize(blockSize_);
+            randGen.fillDoubles(doubles_.data(), blockSize_);
+            nextDouble_ = 0;
+        }
+        return doubles_[nextDouble_++];
+    }
+    
+    double RandomNoiseBlock::nextGaussian(RandomGenerator& randGen){
+        if(gaussians_.size() <= nextGaussian_){
+            gaussians_.resize(blockSize_);
+            randGen.fillGaussians(gaussians_.data(), blockSize_);
+            nextGaussian_ = 0;
+        }
+        return gaussians_[nextGaussian_++];
+    }
+    
+    double RandomNoiseBlock::nextTruncatedGaussian(RandomGenerator& randGen, double mean, double std, double min, double max){
+        return RandomGenerator::truncatedGaussian(nextDouble(randGen), mean, std, min, max);
+    }
+    
+    double RandomNoiseBlock::nextWrappedNormal(RandomGenerator& randGen, double mean, double std){
+        return MathUtils::normalizeOrientaion(mean + std*nextGaussian(randGen));
+    }
 }
@@ -25,17 +25,62 @@
 
 #include <stdio.h>
 #include <random>
+#include <cstdint>
 #include <algorithm>
 #include <memory>
+#include <vector>
 
 namespace loc{
+    
+    /**
+     Counter-based random engine (Philox4x32-10; Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11).
+     The n-th block of four 32-bit words is a pure function of (key, stream, n), so that streams are independent
+     and any position of a stream can be reached in O(1) by discard().
+     **/
+    class Philox4x32{
+    public:
+        using result_type = std::uint32_t;
+        
+        explicit Philox4x32(std::uint64_t key = 0, std::uint64_t stream = 0);
+        
+        static constexpr result_type min(){ return 0; }
+        static constexpr result_type max(){ return 0xFFFFFFFFu; }
+        
+        void seed(std::uint64_t key, std::uint64_t stream = 0);
+        // Skips n outputs
+        void discard(unsigned long long n);
+        
+        result_type operator()(){
+            if(4 <= position_){
+                generate(block_++, buffer_);
+                position_ = 0;
+            }
+            return buffer_[position_++];
+        }
+        
+        // Reserves nBlocks unused blocks and returns the index of the first one.
+        // Outputs not yet consumed from the current block are skipped.
+        std::uint64_t reserveBlocks(std::uint64_t nBlocks);
+        // Computes the block at a given index of this stream
+        void generate(std::uint64_t blockIndex, std::uint32_t out[4]) const;
+        // Computes lanes consecutive blocks at once. out[i][j] is the i-th word of block (firstBlock + j).
+        static constexpr int lanes = 8;
+        void generateLanes(std::uint64_t firstBlock, std::uint32_t out[4][lanes]) const;
+        
+    private:
+        std::uint32_t key_[2];
+        std::uint32_t stream_[2];
+        std::uint64_t block_ = 0;
+        std::uint32_t buffer_[4];
+        int position_ = 4;
+    };
+    
     class RandomGenerator{
         
     private:
-        int max_iteration = 1000000;
-        std::mt19937 engine;
-        std::uniform_real_distribution<> uniformDistribution;
-        std::normal_distribution<> normalDistribution;
+        Philox4x32 engine;
+        bool hasSpareGaussian = false;
+        double spareGaussian = 0;
         
     public:
         using Ptr = std::shared_ptr<RandomGenerator>;
@@ -43,12 +88,56 @@ namespace loc{
         RandomGenerator() = default;
         ~RandomGenerator() = default;
         
+        // Starts the stream-th independent sequence derived from seed
+        RandomGenerator(unsigned long seed, unsigned long stream = 0);
+        void seed(unsigned long seed, unsigned long stream = 0);
+        // Skips n draws of nextDouble()
+        void discard(unsigned long long n);
+        // Draws a value to seed other generators reproducibly
+        unsigned long nextSeed();
+        
         int nextInt(int n);
         double nextDouble();
         double nextGaussian();
         double nextTruncatedGaussian(double mean, double std, double min, double max);
         double nextWrappedNormal(double mean, double std);
         std::vector<int> randomSet(int n, int k);
+        
+        // Bulk generation. Each call consumes whole blocks of the engine.
+        // Fills values with uniform random numbers in [0, 1)
+        void fillDoubles(double values[], size_t n);
+        // Fills values with standard normal random numbers
+        void fillGaussians(double values[], size_t n);
+        // Fills values with normal random numbers (means[i], std) truncated to [min, max]
+        void fillTruncatedGaussians(double values[], const double means[], double std, double min, double max, size_t n);
+        
+        // Normal random number (mean, std) truncated to [min, max] computed by the inverse CDF of a uniform number u in [0, 1)
+        static double truncatedGaussian(double u, double mean, double std, double min, double max);
+    };
+    
+    /**
+     Random numbers generated in blocks by fillDoubles/fillGaussians and handed out one at a time.
+     System models draw per-particle noise from it instead of generating each number separately.
+     **/
+    class RandomNoiseBlock{
+        
+    private:
+        size_t blockSize_;
+        std::vector<double> doubles_;
+        std::vector<double> gaussians_;
+        size_t nextDouble_ = 0;
+        size_t nextGaussian_ = 0;
+        
+    public:
+        explicit RandomNoiseBlock(size_t blockSize = 256);
+        
+        // Discards numbers drawn in advance (e.g. after the generator is reseeded)
+        void clear();
+        
+        double nextDouble(RandomGenerator& randGen);
+        double nextGaussian(RandomGenerator& randGen);
+        double nextTruncatedGaussian(RandomGenerator& randGen, double mean, double std, double min, double max);
+        double nextWrappedNormal(RandomGenerator& randGen, double mean, double std);
     };
     
 }
@@ -73,7 +73,9 @@ void printHelp() {
     std::cout << " -m mapfile          set map data file" << std::endl;
     std::cout << " --wd <dir>          working directory (default .)" << std::endl;
     std::cout << " --train [<name>]    force training parameters (save to <name>)" << std::endl;
-    std::cout << " --gptype <string>   set gptype [normal,light] for training" << std::endl;
+    std::cout << " --gptype <string>   set gptype [normal,light,fitc] for training" << std::endl;
+    std::cout << " --ninducing <int>   set number of inducing points for gptype=fitc" << std::endl;
+    std::cout << " --inducing <string> set placement of inducing points [kmeans,grid] for gptype=fitc" << std::endl;
     std::cout << " --mattype <string>  set matrix type [dense,sparse] for observation model" << std::endl;
     std::cout << " -t testfile         set test csv data file" << std::endl;
     std::cout << " -o output           set output file" << std::endl;
@@ -119,6 +121,8 @@ Option parseArguments(int argc, char *argv[]){
         {"declination",         required_argument , NULL, 0},
         //{"stdY",            required_argument, NULL,  0 },
         {"gptype",   required_argument , NULL, 0},
+        {"ninducing",   required_argument , NULL, 0},
+        {"inducing",   required_argument , NULL, 0},
         {"mattype",   required_argument , NULL, 0},
         {"finalize",   optional_argument , NULL, 0},
         {"binary",   optional_argument , NULL, 0},
@@ -194,11 +198,27 @@ Option parseArguments(int argc, char *argv[]){
                     opt.basicLocalizerOptions.gpType = GPNORMAL;
                 }else if(str=="light"){
                     opt.basicLocalizerOptions.gpType = GPLIGHT;
+                }else if(str=="fitc"){
+                    opt.basicLocalizerOptions.gpType = GPFITC;
                 }else{
                     std::cerr << "Unknown gptype: " << optarg << std::endl;
                     abort();
                 }
             }
+            if (strcmp(long_options[option_index].name, "ninducing") == 0){
+                opt.basicLocalizerOptions.numInducingPoints = atoi(optarg);
+            }
+            if (strcmp(long_options[option_index].name, "inducing") == 0){
+                std::string str(optarg);
+                if(str=="kmeans"){
+                    opt.basicLocalizerOptions.inducingPointPlacement = GaussianProcessFITC::KMEANS;
+                }else if(str=="grid"){
+                    opt.basicLocalizerOptions.inducingPointPlacement = GaussianProcessFITC::GRID;
+                }else{
+                    std::cerr << "Unknown inducing: " << optarg << std::endl;
+                    abort();
+                }
+            }
             if (strcmp(long_options[option_index].name, "mattype") == 0){
                 std::string str(optarg);
                 if(str=="dense"){